@@ -0,0 +1,239 @@
+#!/bin/bash
+#
+#	Benchmark sweep for mdu.
+#
+#	Runs mdu over generated trees for every combination of tree, engine,
+#	scheduler and thread count. Every combination gets warmup runs that are
+#	thrown away and then a number of measured runs. The output of every run is
+#	checked against the manifest of the tree, and so is the exit status.
+#	Engines with extra options may print something else, such as bytes or
+#	inodes, so their runs are checked against a run of the same options with
+#	the dfs scheduler and one thread instead.
+#
+#	GNU du -s, an nftw walker and an fts walker run on the same trees as
+#	baselines, single threaded, and are checked the same way.
+#
+#	Cold runs empty the dentry, inode and page caches before every run so
+#	they measure a tree that has not been touched. That needs the rights to
+#	write /proc/sys/vm/drop_caches, without them the tree is generated again
+#	before every run instead and the runs are marked "regen", since a new tree
+#	is still partly cached.
+#
+#	Writes to the output directory:
+#	runs.csv: One line per measured run.
+#	summary.csv, summary.json: Per combination and cache state the median wall
+#		time with a 95% confidence interval, medians of the other measurements,
+#		and speedup and parallel efficiency against the same combination at one
+#		thread.
+#	baselines.csv: The speedup of every mdu combination over every baseline.
+#
+#	The runs are also appended to a history file together with the git commit
+#	and a fingerprint of the machine, "bench/history.sh compare" compares two
+#	commits.
+#
+#	Author: Leo Juneblad (c19lsd)
+#
+# Version: 2.0
+
+usage() {
+	cat >&2 <<EOF
+usage: bench.sh [options]
+	-t specs      gen-tree specs of the trees, space separated (balanced)
+	-j threads    thread counts, space separated (1 2 4 8)
+	-s names      schedulers, space separated (stack ring steal dfs)
+	-c states     cache states, space separated, warm and/or cold (warm)
+	-b names      baselines, space separated, "" for none (du nftw fts)
+	-e name=args  an engine, extra mdu options given a name, can be repeated
+	              (default=)
+	-w n          warmup runs per combination, not done for cold runs (1)
+	-n n          measured runs per combination (5)
+	-r dir        where the trees are generated (/tmp/mdu-bench)
+	-o dir        output directory (bench/results/<date>)
+	-H file       history file the runs are appended to, "" for none
+	              (bench/history.csv)
+EOF
+	exit 1
+}
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+MDU=$ROOT/mdu
+GEN=$ROOT/tools/gen-tree
+RUN=$ROOT/bench/run
+
+trees="balanced"
+threads="1 2 4 8"
+schedulers="stack ring steal dfs"
+caches="warm"
+baselines="du nftw fts"
+engines=()
+warmup=1
+reps=5
+tree_root=/tmp/mdu-bench
+out=$ROOT/bench/results/$(date +%Y%m%d-%H%M%S)
+history=$ROOT/bench/history.csv
+
+while getopts "t:j:s:c:b:e:w:n:r:o:H:h" opt; do
+	case $opt in
+		t) trees=$OPTARG ;;
+		j) threads=$OPTARG ;;
+		s) schedulers=$OPTARG ;;
+		c) caches=$OPTARG ;;
+		b) baselines=$OPTARG ;;
+		e) engines+=("$OPTARG") ;;
+		w) warmup=$OPTARG ;;
+		n) reps=$OPTARG ;;
+		r) tree_root=$OPTARG ;;
+		o) out=$OPTARG ;;
+		H) history=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+
+if [ ${#engines[@]} -eq 0 ]; then
+	engines=("default=")
+fi
+
+make -s -C "$ROOT" mdu tools/gen-tree bench/run bench/nftw-walk bench/fts-walk || exit 1
+mkdir -p "$out" "$tree_root" || exit 1
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+
+#Reads a value from a manifest.
+manifest_value() {
+	sed -n "s/^$2=//p" "$1"
+}
+
+#Generates the tree for a spec unless it already exists, and prints its path.
+ensure_tree() {
+	local dir=$tree_root/$(echo "$1" | tr ',=' '_-')
+
+	if [ ! -f "$dir.manifest" ]; then
+		if [ -e "$dir" ]; then
+			chmod -R u+rwx "$dir" && rm -rf "$dir"
+		fi
+		echo "generating $1" >&2
+		"$GEN" "$1" "$dir" >&2 || exit 1
+	fi
+	echo "$dir"
+}
+
+#Evicts a tree from the caches, or generates it again without the rights to.
+#Prints the cache state the next run will see.
+evict_tree() {
+	if sync && echo 3 2> /dev/null > /proc/sys/vm/drop_caches; then
+		echo cold
+		return
+	fi
+	chmod -R u+rwx "$1" && rm -rf "$1" && "$GEN" "$2" "$1" > /dev/null || exit 1
+	echo regen
+}
+
+#Counts the system calls of one run with strace, or prints NA without it.
+count_syscalls() {
+	if ! command -v strace > /dev/null; then
+		echo NA
+		return
+	fi
+	strace -f -c -o "$tmp/strace" "$@" > /dev/null 2>&1
+	awk '$NF == "total" { print $4 }' "$tmp/strace"
+}
+
+#Runs one combination in every cache state and appends the runs to runs.csv.
+#Arguments are the engine, scheduler and thread count followed by the command.
+measure() {
+	local name=$1 sched=$2 j=$3 cache state skip rep syscalls got ok
+	local wall user sys nvcsw nivcsw rss status
+	shift 3
+	syscalls=$(count_syscalls "$@")
+
+	for cache in $caches; do
+		echo "$tree $name $sched -j $j $cache" >&2
+		skip=$([ "$cache" = cold ] && echo 0 || echo "$warmup")
+
+		for ((rep = 1; rep <= skip + reps; rep++)); do
+			state=warm
+			if [ "$cache" = cold ]; then
+				state=$(evict_tree "$dir" "$spec") || exit 1
+			fi
+			read -r wall user sys nvcsw nivcsw rss status < \
+				<("$RUN" -o "$tmp/out" -e "$tmp/err" "$@")
+			got=$(awk 'NR == 1 { print $1 }' "$tmp/out")
+			ok=0
+			if [ "$got" = "$want" ] && [ "$status" = "$want_status" ]; then
+				ok=1
+			else
+				echo "  run $rep: printed '$got' exit $status, expected '$want' exit $want_status" >&2
+			fi
+			if [ "$rep" -gt "$skip" ]; then
+				echo "$tree,$entries,$name,$sched,$j,$state,$((rep - skip)),$wall,$user,$sys,$nvcsw,$nivcsw,$rss,$syscalls,$status,$ok" >> "$out/runs.csv"
+			fi
+		done
+	done
+}
+
+echo "tree,entries,engine,scheduler,threads,cache,rep,wall_s,user_s,sys_s,nvcsw,nivcsw,maxrss_kib,syscalls,exit_status,ok" > "$out/runs.csv"
+
+for spec in $trees; do
+	dir=$(ensure_tree "$spec") || exit 1
+	tree=$(basename "$dir")
+	entries=$(manifest_value "$dir.manifest" entries)
+
+	#Root can read the denied directories, everyone else gets an error each.
+	if [ "$(id -u)" -eq 0 ]; then
+		expect_kib=$(manifest_value "$dir.manifest" kib)
+		expect_status=0
+	else
+		expect_kib=$(manifest_value "$dir.manifest" kib_unprivileged)
+		expect_status=$([ "$(manifest_value "$dir.manifest" errors_unprivileged)" -gt 0 ] && echo 1 || echo 0)
+	fi
+
+	#The baselines count hard links every time like mdu, so they print the
+	#same totals.
+	want=$expect_kib
+	want_status=$expect_status
+	for base in $baselines; do
+		case $base in
+			du) measure du baseline 1 du -s -l "$dir" ;;
+			nftw) measure nftw baseline 1 "$ROOT/bench/nftw-walk" "$dir" ;;
+			fts) measure fts baseline 1 "$ROOT/bench/fts-walk" "$dir" ;;
+			*) echo "unknown baseline '$base'" >&2; exit 1 ;;
+		esac
+	done
+
+	for engine in "${engines[@]}"; do
+		name=${engine%%=*}
+		args=${engine#*=}
+
+		#Extra options can change what is printed, the reference run tells
+		#what every scheduler and thread count should print with them.
+		want=$expect_kib
+		want_status=$expect_status
+		if [ -n "$args" ]; then
+			"$MDU" $args --scheduler=dfs -j 1 "$dir" > "$tmp/out" 2> /dev/null
+			want_status=$?
+			want=$(awk 'NR == 1 { print $1 }' "$tmp/out")
+		fi
+
+		for sched in $schedulers; do
+			for j in $threads; do
+				#dfs only ever uses one thread.
+				if [ "$sched" = dfs ] && [ "$j" != "${threads%% *}" ]; then
+					continue
+				fi
+				measure "$name" "$sched" "$j" "$MDU" $args --scheduler="$sched" -j "$j" "$dir"
+			done
+		done
+	done
+done
+
+"$ROOT/bench/summary.awk" -v json="$out/summary.json" -v baselines="$out/baselines.csv" \
+	"$out/runs.csv" > "$out/summary.csv"
+column -s, -t < "$out/summary.csv" 2> /dev/null || cat "$out/summary.csv"
+if [ -n "$history" ]; then
+	"$ROOT/bench/history.sh" add -H "$history" "$out/runs.csv" || exit 1
+fi
+if [ "$(wc -l < "$out/baselines.csv")" -gt 1 ]; then
+	echo
+	column -s, -t < "$out/baselines.csv" 2> /dev/null || cat "$out/baselines.csv"
+fi
+echo "results in $out" >&2
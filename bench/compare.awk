@@ -0,0 +1,156 @@
+#!/usr/bin/awk -f
+#
+#	Compares two commits in the benchmark history, see history.sh.
+#
+#	Needs -v old=commit -v new=commit -v machine=fingerprint
+#	-v threshold=percent -v alpha=significance. Prints one line per
+#	combination and metric with the medians, the change and the p-value, and
+#	marks regressions. Exits with 1 if there are any.
+#
+#	The Mann-Whitney U test compares ranks so it does not assume the runs are
+#	normally distributed. p is from the normal approximation with a continuity
+#	correction, which is rough for very few runs; with 5 runs of each it can
+#	still go below 0.01.
+#
+#	Author: Leo Juneblad (c19lsd)
+#
+# Version: 2.0
+
+BEGIN {
+	FS = ","
+	nkeys = 0
+	regressions = 0
+}
+
+NR == 1 {
+	for(i = 1; i <= NF; i++) {
+		col[$i] = i
+	}
+	next
+}
+
+$col["machine"] == machine && $col["ok"] == 1 && ($col["commit"] == old || $col["commit"] == new) {
+	side = $col["commit"] == old ? "old" : "new"
+	key = $col["tree"] SUBSEP $col["engine"] SUBSEP $col["scheduler"] SUBSEP $col["threads"] SUBSEP $col["cache"]
+	if(!(key in seen)) {
+		keys[++nkeys] = key
+		seen[key] = 1
+	}
+	i = ++n[key, side]
+	if($col["wall_s"] > 0) {
+		tput[key, side, i] = $col["entries"] / $col["wall_s"]
+	}
+	rss[key, side, i] = $col["maxrss_kib"]
+	if($col["syscalls"] != "NA" && $col["entries"] > 0) {
+		sys[key, side] = $col["syscalls"] / $col["entries"]
+	}
+}
+
+#Sorts v[1..len] in place.
+function sort(v, len,    i, j, t) {
+	for(i = 2; i <= len; i++) {
+		t = v[i]
+		for(j = i - 1; j > 0 && v[j] > t; j--) {
+			v[j + 1] = v[j]
+		}
+		v[j + 1] = t
+	}
+}
+
+function median(v, len) {
+	return len % 2 ? v[(len + 1) / 2] : (v[len / 2] + v[len / 2 + 1]) / 2
+}
+
+#Standard normal distribution function, from the erf approximation 7.1.26 in
+#Abramowitz and Stegun.
+function phi(z,    x, t, e) {
+	x = (z < 0 ? -z : z) / sqrt(2)
+	t = 1 / (1 + 0.3275911 * x)
+	e = 1 - t * (0.254829592 + t * (-0.284496736 + t * (1.421413741 + t * (-1.453152027 + t * 1.061405429)))) * exp(-x * x)
+	return z < 0 ? (1 - e) / 2 : (1 + e) / 2
+}
+
+#One sided Mann-Whitney U test that the new runs are larger than the old
+#ones. Also leaves the medians in med_old and med_new.
+function mann_whitney(m, key,    n1, n2, i, j, all, len, r1, u, sd, lo, hi, rank, v) {
+	n1 = n[key, "old"]
+	n2 = n[key, "new"]
+	len = 0
+	for(i = 1; i <= n1; i++) {
+		all[++len] = m[key, "old", i]
+		v[i] = m[key, "old", i]
+	}
+	sort(v, n1)
+	med_old = median(v, n1)
+	for(i = 1; i <= n2; i++) {
+		all[++len] = m[key, "new", i]
+		v[i] = m[key, "new", i]
+	}
+	sort(v, n2)
+	med_new = median(v, n2)
+	sort(all, len)
+
+	#Sum of the ranks of the new runs, ties get the mean of their ranks.
+	r1 = 0
+	for(i = 1; i <= n2; i++) {
+		lo = 0
+		hi = 0
+		for(j = 1; j <= len; j++) {
+			if(all[j] < m[key, "new", i]) {
+				lo++
+			}
+			else if(all[j] == m[key, "new", i]) {
+				hi++
+			}
+		}
+		rank = lo + (hi + 1) / 2
+		r1 += rank
+	}
+	u = r1 - n2 * (n2 + 1) / 2
+	sd = sqrt(n1 * n2 * (n1 + n2 + 1) / 12)
+	return sd > 0 ? 1 - phi((u - n1 * n2 / 2 - 0.5) / sd) : 1
+}
+
+#Prints one comparison. worse is the change in percent in the bad direction.
+function report(key, metric, a, b, worse, p,    part, flag) {
+	split(key, part, SUBSEP)
+	flag = (worse > threshold && (p == "NA" || p < alpha)) ? "REGRESSION" : "ok"
+	if(flag != "ok") {
+		regressions++
+	}
+	printf "%s,%s,%s,%s,%s,%s,%.4g,%.4g,%+.1f,%s,%s\n", part[1], part[2], part[3], part[4], part[5],
+		metric, a, b, worse, (p == "NA" ? p : sprintf("%.4f", p)), flag
+}
+
+END {
+	print "tree,engine,scheduler,threads,cache,metric,old,new,worse_percent,p,verdict"
+	for(k = 1; k <= nkeys; k++) {
+		key = keys[k]
+		if(n[key, "old"] == 0 || n[key, "new"] == 0) {
+			continue
+		}
+
+		#Lower throughput is worse, so the test is on the old runs being larger.
+		for(i = 1; i <= n[key, "old"]; i++) {
+			neg[key, "old", i] = -tput[key, "old", i]
+		}
+		for(i = 1; i <= n[key, "new"]; i++) {
+			neg[key, "new", i] = -tput[key, "new", i]
+		}
+		p = mann_whitney(neg, key)
+		report(key, "entries_per_s", -med_old, -med_new, med_old != 0 ? (med_new - med_old) / -med_old * 100 : 0, p)
+
+		p = mann_whitney(rss, key)
+		report(key, "maxrss_kib", med_old, med_new, med_old != 0 ? (med_new - med_old) / med_old * 100 : 0, p)
+
+		if((key, "old") in sys && (key, "new") in sys) {
+			a = sys[key, "old"]
+			b = sys[key, "new"]
+			report(key, "syscalls_per_entry", a, b, a != 0 ? (b - a) / a * 100 : 0, "NA")
+		}
+	}
+	if(nkeys == 0) {
+		print "no runs of " old " and " new " on machine " machine > "/dev/stderr"
+	}
+	exit regressions > 0
+}
@@ -0,0 +1,79 @@
+/*
+*	Baseline walker built on fts(3), for comparison with mdu.
+*
+*	usage: fts-walk file [files]
+*
+*	Prints the same lines as mdu, the disk usage in KiB of every given file,
+*	counting every hard link like mdu does. Errors are printed and make the
+*	exit status 1.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fts.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+static long long walk(char *path, int *status);
+
+int main(int argc, char *argv[]) {
+	int status = 0;
+
+	if(argc < 2) {
+		fprintf(stderr, "usage: fts-walk file [files]\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(int i = 1; i < argc; i++) {
+		printf("%lld\t%s\n", walk(argv[i], &status) / 2, argv[i]);
+	}
+	return status;
+}
+
+/*
+*	Walks one file.
+*
+*	@path: The file.
+*	@status: Set to 1 on errors.
+*
+*	Returns: The number of 512 byte blocks used.
+*
+*/
+static long long walk(char *path, int *status) {
+	char *paths[] = {path, NULL};
+	long long total = 0;
+	FTSENT *e;
+	FTS *fts;
+
+	if((fts = fts_open(paths, FTS_PHYSICAL | FTS_NOCHDIR, NULL)) == NULL) {
+		fprintf(stderr, "unable to walk '%s': %s\n", path, strerror(errno));
+		*status = 1;
+		return 0;
+	}
+
+	while((e = fts_read(fts)) != NULL) {
+		switch(e->fts_info) {
+			case FTS_DP:
+			break;
+			case FTS_NS:
+			case FTS_ERR:
+			fprintf(stderr, "unable to stat: '%s': %s\n", e->fts_path, strerror(e->fts_errno));
+			*status = 1;
+			break;
+			//The directory itself was counted when fts returned it as FTS_D.
+			case FTS_DNR:
+			fprintf(stderr, "cannot read directory '%s': %s\n", e->fts_path, strerror(e->fts_errno));
+			*status = 1;
+			break;
+			default:
+			total += e->fts_statp->st_blocks;
+		}
+	}
+	fts_close(fts);
+	return total;
+}
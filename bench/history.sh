@@ -0,0 +1,102 @@
+#!/bin/bash
+#
+#	Benchmark history for mdu.
+#
+#	history.sh add [-H file] runs.csv
+#		Appends the runs of a bench.sh sweep to the history, each tagged with
+#		the git commit (with -dirty if there were uncommitted changes), a
+#		fingerprint of the machine and the date.
+#
+#	history.sh compare [-H file] [-m machine] [-t percent] [-a alpha] old new
+#		Compares two commits run on the same machine, this one unless -m gives
+#		another fingerprint. For every combination both have, throughput in
+#		entries per second and peak RSS are compared with a one sided
+#		Mann-Whitney U test and flagged if the new commit is worse by more than
+#		the threshold (5%) at significance alpha (0.05). System calls per entry
+#		are counted, not sampled, so they are flagged on the threshold alone.
+#		Exits with 1 if anything was flagged.
+#
+#	Author: Leo Juneblad (c19lsd)
+#
+# Version: 2.0
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+history=$ROOT/bench/history.csv
+
+usage() {
+	cat >&2 <<EOF2
+usage: history.sh add [-H file] runs.csv
+       history.sh compare [-H file] [-m machine] [-t percent] [-a alpha] old new
+EOF2
+	exit 1
+}
+
+#Prints a fingerprint of the hardware and kernel, runs are only compared
+#between equal fingerprints.
+fingerprint() {
+	{
+		grep -m 1 "model name" /proc/cpuinfo
+		nproc
+		grep MemTotal /proc/meminfo
+		uname -sr
+	} | cksum | cut -d ' ' -f 1
+}
+
+#Prints the short hash of a commit, or of HEAD with -dirty when the tree has
+#uncommitted changes.
+commit() {
+	if [ -n "$1" ]; then
+		case $1 in
+			*-dirty) echo "$(git -C "$ROOT" rev-parse --short=12 "${1%-dirty}")-dirty" ;;
+			*) git -C "$ROOT" rev-parse --short=12 "$1" ;;
+		esac
+		return
+	fi
+	if git -C "$ROOT" diff --quiet HEAD -- 2> /dev/null; then
+		git -C "$ROOT" rev-parse --short=12 HEAD
+	else
+		echo "$(git -C "$ROOT" rev-parse --short=12 HEAD)-dirty"
+	fi
+}
+
+cmd=$1
+shift
+machine=$(fingerprint)
+threshold=5
+alpha=0.05
+
+while getopts "H:m:t:a:" opt; do
+	case $opt in
+		H) history=$OPTARG ;;
+		m) machine=$OPTARG ;;
+		t) threshold=$OPTARG ;;
+		a) alpha=$OPTARG ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+case $cmd in
+	add)
+	[ $# -eq 1 ] || usage
+	rev=$(commit) || exit 1
+	date=$(date +%Y-%m-%dT%H:%M:%S)
+	if [ ! -s "$history" ]; then
+		echo "commit,machine,date,$(head -n 1 "$1")" > "$history"
+	fi
+	tail -n +2 "$1" | sed "s/^/$rev,$machine,$date,/" >> "$history"
+	echo "appended to $history as $rev on machine $machine" >&2
+	;;
+
+	compare)
+	[ $# -eq 2 ] || usage
+	old=$(commit "$1") || exit 1
+	new=$(commit "$2") || exit 1
+	"$ROOT/bench/compare.awk" -v old="$old" -v new="$new" -v machine="$machine" \
+		-v threshold="$threshold" -v alpha="$alpha" "$history"
+	;;
+
+	*)
+	usage
+	;;
+esac
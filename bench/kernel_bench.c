@@ -0,0 +1,203 @@
+/*
+*	Microbenchmark for the scanning kernels.
+*
+*	Runs the kernels from kernel.h over an in-memory directory so the time per
+*	entry is the cost of the kernel itself and not of the disk. Compares the
+*	specialized kernels with the generic kernel for the same options to show
+*	what checking the options at runtime costs.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "scan.h"
+#include "report.h"
+#include "fs.h"
+#include "record.h"
+#include "stats.h"
+#include "lathist.h"
+#include "progress.h"
+#include "probes.h"
+#include "mem.h"
+#include "top.h"
+#include "sizehist.h"
+#include "owner.h"
+
+#define NR_ENTRIES 100000
+#define ROUNDS 25
+
+struct fake_dir {
+	int pos;
+};
+
+static struct dirent *fake_entries;
+static struct fake_dir fake_handle;
+
+static struct fake_dir *fake_opendir(const char *path);
+static struct dirent *fake_readdir(struct fake_dir *dir);
+static int fake_lstat(const char *path, struct stat *st);
+static double bench_kernel(kernel_fn kernel);
+static double now(void);
+
+#define KERNEL_DIR struct fake_dir
+#define KERNEL_OPENDIR(path) fake_opendir(path)
+#define KERNEL_READDIR(dir) fake_readdir(dir)
+#define KERNEL_CLOSEDIR(dir) 0
+#define KERNEL_LSTAT(path, st) fake_lstat(path, st)
+#define KERNEL_VARIANT default
+#define KERNEL_FLAGS 0
+#include "kernel.h"
+
+#define KERNEL_DIR struct fake_dir
+#define KERNEL_OPENDIR(path) fake_opendir(path)
+#define KERNEL_READDIR(dir) fake_readdir(dir)
+#define KERNEL_CLOSEDIR(dir) 0
+#define KERNEL_LSTAT(path, st) fake_lstat(path, st)
+#define KERNEL_VARIANT exclude
+#define KERNEL_FLAGS KF_EXCLUDE
+#include "kernel.h"
+
+#define KERNEL_DIR struct fake_dir
+#define KERNEL_OPENDIR(path) fake_opendir(path)
+#define KERNEL_READDIR(dir) fake_readdir(dir)
+#define KERNEL_CLOSEDIR(dir) 0
+#define KERNEL_LSTAT(path, st) fake_lstat(path, st)
+#define KERNEL_VARIANT generic
+#define KERNEL_FLAGS kernel_flags
+#include "kernel.h"
+
+int main(void) {
+	double t_default, t_generic, t_exclude, t_generic_exclude;
+
+	if((fake_entries = calloc(NR_ENTRIES, sizeof(struct dirent))) == NULL) {
+		perror("calloc 'fake_entries': ");
+		exit(EXIT_FAILURE);
+	}
+	for(int i = 0; i < NR_ENTRIES; i++) {
+		snprintf(fake_entries[i].d_name, sizeof(fake_entries[i].d_name), "file%d.dat", i);
+		fake_entries[i].d_type = DT_REG;
+	}
+	report_init(1, 1);
+
+	kernel_flags = 0;
+	t_default = bench_kernel(get_directory_size_default);
+	t_generic = bench_kernel(get_directory_size_generic);
+
+	//A pattern that never matches, so only the cost of the check is measured.
+	add_exclude("*.never");
+	kernel_flags = KF_EXCLUDE;
+	t_exclude = bench_kernel(get_directory_size_exclude);
+	t_generic_exclude = bench_kernel(get_directory_size_generic);
+
+	printf("%-24s %10s\n", "kernel", "ns/entry");
+	printf("%-24s %10.2f\n", "default", t_default);
+	printf("%-24s %10.2f\n", "generic (no options)", t_generic);
+	printf("%-24s %10.2f\n", "exclude", t_exclude);
+	printf("%-24s %10.2f\n", "generic (exclude)", t_generic_exclude);
+
+	free_excludes();
+	report_free();
+	free(fake_entries);
+	return 0;
+}
+
+/*
+*	Opens the in-memory directory.
+*
+*	@path: Unused.
+*
+*	Returns: The directory handle.
+*
+*/
+static struct fake_dir *fake_opendir(const char *path) {
+	(void)path;
+	fake_handle.pos = 0;
+	return &fake_handle;
+}
+
+/*
+*	Reads the next entry of the in-memory directory.
+*
+*	@dir: The directory handle.
+*
+*	Returns: The entry or NULL at the end of the directory.
+*
+*/
+static struct dirent *fake_readdir(struct fake_dir *dir) {
+	if(dir->pos == NR_ENTRIES) {
+		return NULL;
+	}
+	return &fake_entries[dir->pos++];
+}
+
+/*
+*	Fills in a stat struct for a regular file of 4 KiB.
+*
+*	@path: Unused.
+*	@st: The stat struct.
+*
+*	Returns: 0.
+*
+*/
+static int fake_lstat(const char *path, struct stat *st) {
+	(void)path;
+	st->st_mode = S_IFREG | 0644;
+	st->st_blocks = 8;
+	return 0;
+}
+
+/*
+*	Runs a kernel over the in-memory directory a number of times.
+*
+*	@kernel: The kernel.
+*
+*	Returns: The fastest time per entry in nanoseconds.
+*
+*/
+static double bench_kernel(kernel_fn kernel) {
+	double best = 0;
+
+	for(int i = 0; i < ROUNDS; i++) {
+		struct dir_info dir;
+		double start;
+
+		if((dir.name = strdup("bench")) == NULL) {
+			perror("strdup: ");
+			exit(EXIT_FAILURE);
+		}
+		dir.parent_id = 0;
+		dir.node = NULL;
+
+		start = now();
+		if(kernel(dir, 0) != 8LL * NR_ENTRIES) {
+			fprintf(stderr, "kernel returned the wrong size\n");
+			exit(EXIT_FAILURE);
+		}
+		double t = (now() - start) * 1e9 / NR_ENTRIES;
+		if(i == 0 || t < best) {
+			best = t;
+		}
+	}
+	return best;
+}
+
+/*
+*	Reads the monotonic clock.
+*
+*	Returns: The time in seconds.
+*
+*/
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,352 @@
+/*
+*	Microbenchmarks for the hot operations of mdu.
+*
+*	Every benchmark runs at 1, 2, 4, ... up to the given number of threads and
+*	prints the wall time per operation and the throughput relative to one
+*	thread, so a replacement for any of them can be judged on its own:
+*
+*	sched-<name>: push and pop of a scheduler, walking a tree of fanout
+*								MICRO_FANOUT and depth MICRO_DEPTH without touching
+*								the disk. dfs only runs on one thread.
+*	path: Building the path of an entry the way the kernels do.
+*	readdir: Reading a directory of MICRO_FILES entries with opendir, readdir
+*					 and closedir, per entry.
+*	size-lock: Adding a size to a total under a mutex, like main does for
+*						 every directory.
+*	size-atomic: The same with an atomic add, for comparison.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "sched.h"
+
+#define MICRO_FANOUT 8
+#define MICRO_DEPTH 6
+#define MICRO_OPS 1000000
+#define MICRO_FILES 10000
+#define MICRO_READS 20
+
+typedef long long (*micro_fn)(int thread_id, int nr_threads);
+
+struct micro_thread {
+	micro_fn fn;
+	int thread_id;
+	int nr_threads;
+	long long ops;
+};
+
+static void run(const char *name, micro_fn fn, int max_threads);
+static void *micro_thread(void *arg);
+static long long bench_sched(int thread_id, int nr_threads);
+static long long bench_path(int thread_id, int nr_threads);
+static long long bench_readdir(int thread_id, int nr_threads);
+static long long bench_size_lock(int thread_id, int nr_threads);
+static long long bench_size_atomic(int thread_id, int nr_threads);
+static void make_dir(void);
+static void remove_dir(void);
+static double now(void);
+
+//-------global variables--------
+static const struct scheduler *micro_sched;
+static atomic_int sched_done;
+static pthread_barrier_t start_barrier;
+static pthread_mutex_t size_lock = PTHREAD_MUTEX_INITIALIZER;
+static long long total_size;
+static atomic_llong atomic_size;
+static char dir_path[] = "/tmp/mdu-micro-XXXXXX";
+
+int main(int argc, char *argv[]) {
+	static const char *scheds[] = {"stack", "ring", "steal", "dfs", NULL};
+	int max_threads = 8;
+	int opt;
+
+	while((opt = getopt(argc, argv, "j:")) != -1) {
+		if(opt != 'j' || (max_threads = atoi(optarg)) < 1) {
+			fprintf(stderr, "usage: micro_bench [-j max_threads]\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	printf("%-16s %8s %12s %10s\n", "benchmark", "threads", "ns/op", "scaling");
+	for(int i = 0; scheds[i] != NULL; i++) {
+		char name[32];
+		micro_sched = find_scheduler(scheds[i]);
+		snprintf(name, sizeof(name), "sched-%s", scheds[i]);
+		run(name, bench_sched, strcmp(scheds[i], "dfs") == 0 ? 1 : max_threads);
+	}
+	run("path", bench_path, max_threads);
+
+	make_dir();
+	run("readdir", bench_readdir, max_threads);
+	remove_dir();
+
+	run("size-lock", bench_size_lock, max_threads);
+	run("size-atomic", bench_size_atomic, max_threads);
+	return 0;
+}
+
+/*
+*	Runs a benchmark at 1, 2, 4, ... threads and prints the results.
+*
+*	@name: Name of the benchmark.
+*	@fn: The benchmark, called once per thread, returns the number of
+*			 operations the thread did.
+*	@max_threads: The largest number of threads.
+*
+*	Returns: Nothing.
+*
+*/
+static void run(const char *name, micro_fn fn, int max_threads) {
+	double base = 0;
+
+	for(int n = 1; n <= max_threads; n = n * 2 > max_threads && n < max_threads ? max_threads : n * 2) {
+		pthread_t threads[n];
+		struct micro_thread args[n];
+		long long ops = 0;
+		double start, elapsed, per_op;
+
+		if(pthread_barrier_init(&start_barrier, NULL, n + 1) != 0) {
+			perror("pthread_barrier_init: ");
+			exit(EXIT_FAILURE);
+		}
+		for(int i = 0; i < n; i++) {
+			args[i] = (struct micro_thread){fn, i, n, 0};
+			if(pthread_create(&threads[i], NULL, micro_thread, &args[i]) != 0) {
+				perror("pthread_create: ");
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		//Threads are created before the clock starts.
+		pthread_barrier_wait(&start_barrier);
+		start = now();
+		for(int i = 0; i < n; i++) {
+			pthread_join(threads[i], NULL);
+			ops += args[i].ops;
+		}
+		elapsed = now() - start;
+		pthread_barrier_destroy(&start_barrier);
+
+		per_op = elapsed * 1e9 / ops;
+		if(n == 1) {
+			base = per_op;
+		}
+		printf("%-16s %8d %12.2f %10.2f\n", name, n, per_op, base / per_op);
+		fflush(stdout);
+	}
+}
+
+/*
+*	Thread function of the benchmarks.
+*
+*	@arg: The struct micro_thread of the thread.
+*
+*	Returns: arg.
+*
+*/
+static void *micro_thread(void *arg) {
+	struct micro_thread *t = arg;
+
+	if(t->fn == bench_sched && t->thread_id == 0) {
+		micro_sched->init(t->nr_threads);
+		struct dir_info root = {0, 0, NULL, NULL};
+		micro_sched->push(0, root);
+	}
+	pthread_barrier_wait(&start_barrier);
+	t->ops = t->fn(t->thread_id, t->nr_threads);
+	return arg;
+}
+
+/*
+*	Walks a tree through the scheduler, every popped directory pushes its
+*	children. The depth is kept in trace_id so nothing is allocated.
+*
+*	@thread_id: The id of the thread.
+*	@nr_threads: Number of threads.
+*
+*	Returns: The number of directories the thread popped.
+*
+*/
+static long long bench_sched(int thread_id, int nr_threads) {
+	struct dir_info f;
+	long long ops = 0;
+
+	(void)nr_threads;
+	while(micro_sched->pop(thread_id, &f)) {
+		if(f.trace_id < MICRO_DEPTH) {
+			struct dir_info child = {0, f.trace_id + 1, NULL, NULL};
+			for(int i = 0; i < MICRO_FANOUT; i++) {
+				micro_sched->push(thread_id, child);
+			}
+		}
+		ops++;
+	}
+
+	//The last thread out frees the scheduler, the others have stopped using it.
+	if(atomic_fetch_add(&sched_done, 1) + 1 == nr_threads) {
+		micro_sched->destroy();
+		atomic_store(&sched_done, 0);
+	}
+	return ops;
+}
+
+/*
+*	Builds entry paths with malloc and sprintf.
+*
+*	@thread_id: The id of the thread.
+*	@nr_threads: Number of threads.
+*
+*	Returns: The number of paths built.
+*
+*/
+static long long bench_path(int thread_id, int nr_threads) {
+	const char *parent = "/tmp/mdu-bench/balanced/d.3.1f4a/d.4.2b7c";
+	const char *name = "f.1234.dat";
+	long long ops = MICRO_OPS / nr_threads;
+
+	(void)thread_id;
+	for(long long i = 0; i < ops; i++) {
+		char *temp;
+		if((temp = malloc((strlen(parent) + strlen(name) + 2) * sizeof(char))) == NULL) {
+			perror("malloc: ");
+			exit(EXIT_FAILURE);
+		}
+		sprintf(temp, "%s/%s", parent, name);
+		//Keeps the compiler from removing the path.
+		__asm__ volatile("" : : "r"(temp) : "memory");
+		free(temp);
+	}
+	return ops;
+}
+
+/*
+*	Reads the benchmark directory a number of times.
+*
+*	@thread_id: The id of the thread.
+*	@nr_threads: Number of threads.
+*
+*	Returns: The number of entries read.
+*
+*/
+static long long bench_readdir(int thread_id, int nr_threads) {
+	long long ops = 0;
+	int reads = MICRO_READS / nr_threads > 0 ? MICRO_READS / nr_threads : 1;
+
+	(void)thread_id;
+	for(int i = 0; i < reads; i++) {
+		DIR *dir;
+		if((dir = opendir(dir_path)) == NULL) {
+			perror("opendir: ");
+			exit(EXIT_FAILURE);
+		}
+		while(readdir(dir) != NULL) {
+			ops++;
+		}
+		closedir(dir);
+	}
+	return ops;
+}
+
+/*
+*	Adds to a total under a mutex.
+*
+*	@thread_id: The id of the thread.
+*	@nr_threads: Number of threads.
+*
+*	Returns: The number of additions.
+*
+*/
+static long long bench_size_lock(int thread_id, int nr_threads) {
+	long long ops = MICRO_OPS / nr_threads;
+
+	for(long long i = 0; i < ops; i++) {
+		pthread_mutex_lock(&size_lock);
+		total_size += thread_id + 8;
+		pthread_mutex_unlock(&size_lock);
+	}
+	return ops;
+}
+
+/*
+*	Adds to a total with an atomic add.
+*
+*	@thread_id: The id of the thread.
+*	@nr_threads: Number of threads.
+*
+*	Returns: The number of additions.
+*
+*/
+static long long bench_size_atomic(int thread_id, int nr_threads) {
+	long long ops = MICRO_OPS / nr_threads;
+
+	for(long long i = 0; i < ops; i++) {
+		atomic_fetch_add_explicit(&atomic_size, thread_id + 8, memory_order_relaxed);
+	}
+	return ops;
+}
+
+/*
+*	Creates the directory read by the readdir benchmark.
+*
+*	Returns: Nothing.
+*
+*/
+static void make_dir(void) {
+	char path[sizeof(dir_path) + 16];
+
+	if(mkdtemp(dir_path) == NULL) {
+		perror("mkdtemp: ");
+		exit(EXIT_FAILURE);
+	}
+	for(int i = 0; i < MICRO_FILES; i++) {
+		int fd;
+		snprintf(path, sizeof(path), "%s/f.%d", dir_path, i);
+		if((fd = open(path, O_CREAT | O_WRONLY, 0644)) < 0) {
+			perror("open: ");
+			exit(EXIT_FAILURE);
+		}
+		close(fd);
+	}
+}
+
+/*
+*	Removes the directory read by the readdir benchmark.
+*
+*	Returns: Nothing.
+*
+*/
+static void remove_dir(void) {
+	char path[sizeof(dir_path) + 16];
+
+	for(int i = 0; i < MICRO_FILES; i++) {
+		snprintf(path, sizeof(path), "%s/f.%d", dir_path, i);
+		unlink(path);
+	}
+	rmdir(dir_path);
+}
+
+/*
+*	Reads the monotonic clock.
+*
+*	Returns: The time in seconds.
+*
+*/
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
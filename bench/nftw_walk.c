@@ -0,0 +1,73 @@
+/*
+*	Baseline walker built on nftw(3), for comparison with mdu.
+*
+*	usage: nftw-walk file [files]
+*
+*	Prints the same lines as mdu, the disk usage in KiB of every given file,
+*	counting every hard link like mdu does. Errors are printed and make the
+*	exit status 1.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ftw.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define NFTW_FDS 64
+
+static int visit(const char *path, const struct stat *st, int type, struct FTW *ftw);
+
+//-------global variables--------
+static long long total;
+static int status;
+
+int main(int argc, char *argv[]) {
+	if(argc < 2) {
+		fprintf(stderr, "usage: nftw-walk file [files]\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(int i = 1; i < argc; i++) {
+		total = 0;
+		if(nftw(argv[i], visit, NFTW_FDS, FTW_PHYS) < 0) {
+			fprintf(stderr, "unable to walk '%s': %s\n", argv[i], strerror(errno));
+			status = 1;
+		}
+		printf("%lld\t%s\n", total / 2, argv[i]);
+	}
+	return status;
+}
+
+/*
+*	Adds the blocks of a file to the total.
+*
+*	@path: The file.
+*	@st: Its stat.
+*	@type: What nftw found.
+*	@ftw: Unused.
+*
+*	Returns: 0 so the walk goes on.
+*
+*/
+static int visit(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+	(void)ftw;
+
+	if(type == FTW_NS) {
+		fprintf(stderr, "unable to stat: '%s'\n", path);
+		status = 1;
+		return 0;
+	}
+	if(type == FTW_DNR) {
+		fprintf(stderr, "cannot read directory '%s'\n", path);
+		status = 1;
+	}
+	total += st->st_blocks;
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+*	Runs a command and prints what it cost.
+*
+*	usage: run [-o stdout_file] [-e stderr_file] command [args]
+*
+*	Prints one line with the wall time, user and system time in seconds,
+*	voluntary and involuntary context switches, peak RSS in KiB and the exit
+*	status of the command. Used by bench.sh instead of /usr/bin/time, which is
+*	not installed everywhere and whose output format differs between systems.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+static void redirect(const char *path, int fd);
+static double seconds(struct timeval tv);
+
+int main(int argc, char *argv[]) {
+	const char *out = NULL;
+	const char *err = NULL;
+	struct timespec start, end;
+	struct rusage usage;
+	int opt, status;
+	pid_t pid;
+
+	while((opt = getopt(argc, argv, "+o:e:")) != -1) {
+		switch(opt) {
+			case 'o':
+			out = optarg;
+			break;
+			case 'e':
+			err = optarg;
+			break;
+			default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if(optind == argc) {
+		fprintf(stderr, "usage: run [-o stdout_file] [-e stderr_file] command [args]\n");
+		exit(EXIT_FAILURE);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if((pid = fork()) < 0) {
+		perror("fork: ");
+		exit(EXIT_FAILURE);
+	}
+	if(pid == 0) {
+		redirect(out, STDOUT_FILENO);
+		redirect(err, STDERR_FILENO);
+		execvp(argv[optind], &argv[optind]);
+		perror("execvp: ");
+		_exit(127);
+	}
+
+	if(wait4(pid, &status, 0, &usage) < 0) {
+		perror("wait4: ");
+		exit(EXIT_FAILURE);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("%.6f %.6f %.6f %ld %ld %ld %d\n",
+		(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9,
+		seconds(usage.ru_utime), seconds(usage.ru_stime),
+		usage.ru_nvcsw, usage.ru_nivcsw, usage.ru_maxrss,
+		WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+	return 0;
+}
+
+/*
+*	Points a file descriptor at a file.
+*
+*	@path: The file, nothing is done if it is NULL.
+*	@fd: The file descriptor.
+*
+*	Returns: Nothing.
+*
+*/
+static void redirect(const char *path, int fd) {
+	int file;
+
+	if(path == NULL) {
+		return;
+	}
+	if((file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0 || dup2(file, fd) < 0) {
+		perror(path);
+		_exit(127);
+	}
+	close(file);
+}
+
+/*
+*	Converts a timeval to seconds.
+*
+*	@tv: The timeval.
+*
+*	Returns: The time in seconds.
+*
+*/
+static double seconds(struct timeval tv) {
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
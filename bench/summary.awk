@@ -0,0 +1,166 @@
+#!/usr/bin/awk -f
+#
+#	Summarizes runs.csv from bench.sh.
+#
+#	One line per tree, engine, scheduler, thread count and cache state with the
+#	median wall time and a 95% confidence interval for it, the medians of CPU
+#	time, context switches and peak RSS, and speedup and efficiency against one
+#	thread with the same cache state.
+#	Writes CSV to stdout and, if -v json=file is given, the same as JSON.
+#
+#	Runs with the scheduler "baseline" are other programs. With -v
+#	baselines=file every other combination is compared to each baseline on the
+#	same tree and cache state in that file.
+#
+#	The interval for the median uses order statistics so it does not assume
+#	the times are normally distributed, with few runs it is simply min to max.
+#
+#	Author: Leo Juneblad (c19lsd)
+#
+# Version: 2.0
+
+BEGIN {
+	FS = ","
+	nkeys = 0
+}
+
+NR == 1 {
+	for(i = 1; i <= NF; i++) {
+		col[$i] = i
+	}
+	next
+}
+
+{
+	key = $col["tree"] SUBSEP $col["engine"] SUBSEP $col["scheduler"] SUBSEP $col["threads"] SUBSEP $col["cache"]
+	if(!(key in n)) {
+		keys[++nkeys] = key
+		n[key] = 0
+		failures[key] = 0
+	}
+	i = ++n[key]
+	wall[key, i] = $col["wall_s"]
+	cpu[key, i] = $col["user_s"] + $col["sys_s"]
+	nvcsw[key, i] = $col["nvcsw"]
+	nivcsw[key, i] = $col["nivcsw"]
+	rss[key, i] = $col["maxrss_kib"]
+	syscalls[key] = $col["syscalls"]
+	if($col["ok"] != 1) {
+		failures[key]++
+	}
+}
+
+#Sorts v[1..len] in place.
+function sort(v, len,    i, j, t) {
+	for(i = 2; i <= len; i++) {
+		t = v[i]
+		for(j = i - 1; j > 0 && v[j] > t; j--) {
+			v[j + 1] = v[j]
+		}
+		v[j + 1] = t
+	}
+}
+
+#Copies one measurement of a key to v and sorts it.
+function collect(m, key, v,    i) {
+	for(i = 1; i <= n[key]; i++) {
+		v[i] = m[key, i]
+	}
+	sort(v, n[key])
+}
+
+function median(v, len) {
+	return len % 2 ? v[(len + 1) / 2] : (v[len / 2] + v[len / 2 + 1]) / 2
+}
+
+function lower_rank(len,    r) {
+	r = int(len / 2 - 0.98 * sqrt(len))
+	return r < 1 ? 1 : r
+}
+
+function upper_rank(len,    r) {
+	r = 1 + len / 2 + 0.98 * sqrt(len)
+	r = r == int(r) ? r : int(r) + 1
+	return r > len ? len : r
+}
+
+END {
+	header = "tree,engine,scheduler,threads,cache,runs,failures,wall_median_s,wall_ci_low_s,wall_ci_high_s,cpu_median_s,nvcsw_median,nivcsw_median,maxrss_median_kib,syscalls,speedup,efficiency"
+	print header
+	nfields = split(header, names, ",")
+	if(json != "") {
+		print "[" > json
+	}
+
+	#Every median first, the thread counts can come in any order.
+	for(k = 1; k <= nkeys; k++) {
+		collect(wall, keys[k], v)
+		med[keys[k]] = median(v, n[keys[k]])
+	}
+
+	for(k = 1; k <= nkeys; k++) {
+		key = keys[k]
+		split(key, part, SUBSEP)
+		len = n[key]
+
+		collect(wall, key, v)
+		lo = v[lower_rank(len)]
+		hi = v[upper_rank(len)]
+		collect(cpu, key, v)
+		c = median(v, len)
+		collect(nvcsw, key, v)
+		vol = median(v, len)
+		collect(nivcsw, key, v)
+		invol = median(v, len)
+		collect(rss, key, v)
+		r = median(v, len)
+
+		base = part[1] SUBSEP part[2] SUBSEP part[3] SUBSEP 1 SUBSEP part[5]
+		if(base in med && med[key] > 0) {
+			speedup = sprintf("%.3f", med[base] / med[key])
+			efficiency = sprintf("%.3f", speedup / part[4])
+		}
+		else {
+			speedup = "NA"
+			efficiency = "NA"
+		}
+
+		line = sprintf("%s,%s,%s,%d,%s,%d,%d,%.6f,%.6f,%.6f,%.6f,%d,%d,%d,%s,%s,%s",
+			part[1], part[2], part[3], part[4], part[5], len, failures[key], med[key], lo, hi,
+			c, vol, invol, r, syscalls[key], speedup, efficiency)
+		print line
+
+		if(json != "") {
+			split(line, value, ",")
+			printf "  {" > json
+			for(i = 1; i <= nfields; i++) {
+				quote = (i <= 3 || i == 5 || value[i] == "NA") ? "\"" : ""
+				printf "%s\"%s\": %s%s%s", (i > 1 ? ", " : ""), names[i], quote, value[i], quote > json
+			}
+			printf "}%s\n", (k < nkeys ? "," : "") > json
+		}
+	}
+
+	if(json != "") {
+		print "]" > json
+	}
+
+	if(baselines != "") {
+		print "tree,cache,engine,scheduler,threads,baseline,baseline_wall_median_s,wall_median_s,speedup" > baselines
+		for(k = 1; k <= nkeys; k++) {
+			split(keys[k], part, SUBSEP)
+			if(part[3] == "baseline") {
+				continue
+			}
+			for(b = 1; b <= nkeys; b++) {
+				split(keys[b], bpart, SUBSEP)
+				if(bpart[3] != "baseline" || bpart[1] != part[1] || bpart[5] != part[5]) {
+					continue
+				}
+				printf "%s,%s,%s,%s,%d,%s,%.6f,%.6f,%s\n", part[1], part[5], part[2], part[3], part[4],
+					bpart[2], med[keys[b]], med[keys[k]],
+					(med[keys[k]] > 0 ? sprintf("%.3f", med[keys[b]] / med[keys[k]]) : "NA") > baselines
+			}
+		}
+	}
+}
@@ -0,0 +1,119 @@
+/*
+*	Filesystem backend selection and the POSIX backend.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "fs.h"
+
+//Waits shorter than this spin instead of sleeping.
+#define FS_SPIN_NS 50000
+
+static void *posix_opendir(const char *path);
+static struct dirent *posix_readdir(void *dir);
+static int posix_closedir(void *dir);
+
+const struct fs_ops posix_fs = {
+	"posix", posix_opendir, posix_readdir, posix_closedir, lstat
+};
+
+//-------global variables--------
+const struct fs_ops *fs = &posix_fs;
+
+/*
+*	Selects the backend given to --fs.
+*
+*	@spec: "posix", "synth:" followed by a shape spec or "replay:" followed by
+*				 the path of a trace.
+*
+*	Returns: False if the spec is not valid.
+*
+*/
+bool select_fs(const char *spec) {
+	if(strcmp(spec, "posix") == 0) {
+		fs = &posix_fs;
+		return true;
+	}
+	if(strncmp(spec, "synth:", 6) == 0 && synth_init(spec + 6)) {
+		fs = &synth_fs;
+		return true;
+	}
+	if(strncmp(spec, "replay:", 7) == 0 && replay_init(spec + 7)) {
+		fs = &replay_fs;
+		return true;
+	}
+	return false;
+}
+
+/*
+*	Waits for a number of nanoseconds. Short waits spin since sleeping would
+*	take far longer than asked for.
+*
+*	@ns: How long to wait.
+*
+*	Returns: Nothing.
+*
+*/
+void fs_delay(long long ns) {
+	struct timespec start, now;
+
+	if(ns <= 0) {
+		return;
+	}
+	if(ns >= FS_SPIN_NS) {
+		struct timespec req = {ns / 1000000000, ns % 1000000000};
+		while(nanosleep(&req, &req) < 0 && errno == EINTR);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while((now.tv_sec - start.tv_sec) * 1000000000LL + now.tv_nsec - start.tv_nsec < ns);
+}
+
+/*
+*	opendir with an opaque handle.
+*
+*	@path: The directory.
+*
+*	Returns: The handle or NULL with errno set.
+*
+*/
+static void *posix_opendir(const char *path) {
+	return opendir(path);
+}
+
+/*
+*	readdir with an opaque handle.
+*
+*	@dir: The handle.
+*
+*	Returns: The next entry or NULL at the end.
+*
+*/
+static struct dirent *posix_readdir(void *dir) {
+	return readdir(dir);
+}
+
+/*
+*	closedir with an opaque handle.
+*
+*	@dir: The handle.
+*
+*	Returns: 0 or -1 with errno set.
+*
+*/
+static int posix_closedir(void *dir) {
+	return closedir(dir);
+}
@@ -0,0 +1,51 @@
+/*
+*	Filesystem backends for mdu.
+*
+*	The kernels call the POSIX functions directly unless another backend is
+*	selected with --fs, then they go through the operations below. Handles
+*	returned by opendir are opaque to the kernels.
+*
+*	posix: The real filesystem.
+*	synth:<spec>: A tree described by a shape spec (see shape.h) that only
+*								exists in memory, so no system calls are made at all.
+*	replay:<file>: A trace written with --record (see record.h). With
+*								 --replay-latency every call takes as long as it did when
+*								 it was recorded.
+*
+*	--latency wraps the selected backend in one that delays every lstat and
+*	opendir, see latency.c.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef FS_H
+#define FS_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+struct fs_ops {
+	const char *name;
+	void *(*opendir)(const char *path);
+	struct dirent *(*readdir)(void *dir);
+	int (*closedir)(void *dir);
+	int (*lstat)(const char *path, struct stat *st);
+};
+
+extern const struct fs_ops posix_fs;
+extern const struct fs_ops synth_fs;
+extern const struct fs_ops replay_fs;
+extern const struct fs_ops latency_fs;
+extern const struct fs_ops *fs;
+extern bool replay_latency;
+
+bool select_fs(const char *spec);
+bool synth_init(const char *spec);
+bool replay_init(const char *path);
+bool latency_init(const char *spec, const struct fs_ops *backend);
+void fs_delay(long long ns);
+
+#endif
@@ -0,0 +1,413 @@
+/*
+*	Template for the directory scanning kernels.
+*
+*	This file has no include guard, scan.c includes it once per kernel variant
+*	after defining:
+*
+*	KERNEL_VARIANT: Suffix of the generated functions, the kernel is called
+*									get_directory_size_<variant>.
+*	KERNEL_FLAGS: The KF_* flags of the variant. When it is a constant the
+*								compiler removes every feature that is off, so the variants
+*								only pay for what they use.
+*
+*	Kernels with KF_RECORD time every call and write what they see to the
+*	trace, see record.h. Kernels with KF_STATS count and time every call in
+*	the statistics of the thread, see stats.h, and kernels with KF_LATHIST
+*	add every call to the latency histograms, see lathist.h. Kernels with
+*	KF_PROGRESS count entries and found directories for --progress, see
+*	progress.h, and kernels with KF_COUNT count the entries of every root.
+*	Kernels with KF_MEM count the memory of the directory paths and walk
+*	directories in place while mem_lean() is true, see mem.h. They keep the
+*	directories found in lean mode on a stack of their own instead of
+*	recursing, so a deep tree cannot overflow the thread stack and the
+*	directories are still begun and ended one at a time in the trace. Kernels with
+*	KF_TOP hand the sizes to the heaps of --top, see top.h, and the paths of
+*	the directories are then owned and freed by their nodes. Kernels with
+*	KF_HIST count every other file in the size histogram of its root, see
+*	sizehist.h, and kernels with KF_APPARENT add the apparent size of every
+*	entry to its root. Kernels with KF_INODES only count entries, they trust
+*	d_type and call lstat only for entries whose type readdir does not know.
+*	Kernels with KF_OWNER add every entry to its owner and group, see owner.h.
+*
+*	Kernels with KF_VFS go through the backend selected with --fs, the others
+*	call the POSIX functions directly. Both can be replaced by defining
+*	KERNEL_DIR, KERNEL_OPENDIR, KERNEL_READDIR, KERNEL_CLOSEDIR and
+*	KERNEL_LSTAT, which the benchmarks use to time the kernels without touching
+*	the disk.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef KERNEL_DIR
+#define KERNEL_DIR void
+#define KERNEL_OPENDIR(path) \
+	((KERNEL_FLAGS & KF_VFS) ? fs->opendir(path) : (void *)opendir(path))
+#define KERNEL_READDIR(dir) \
+	((KERNEL_FLAGS & KF_VFS) ? fs->readdir(dir) : readdir(dir))
+#define KERNEL_CLOSEDIR(dir) \
+	((KERNEL_FLAGS & KF_VFS) ? fs->closedir(dir) : closedir(dir))
+#define KERNEL_LSTAT(path, st) \
+	((KERNEL_FLAGS & KF_VFS) ? fs->lstat(path, st) : lstat(path, st))
+#endif
+
+#define KERNEL_RECORD (KERNEL_FLAGS & KF_RECORD)
+#define KERNEL_STATS (KERNEL_FLAGS & KF_STATS)
+#define KERNEL_LATHIST (KERNEL_FLAGS & KF_LATHIST)
+#define KERNEL_PROGRESS (KERNEL_FLAGS & KF_PROGRESS)
+#define KERNEL_COUNT (KERNEL_FLAGS & KF_COUNT)
+#define KERNEL_MEM (KERNEL_FLAGS & KF_MEM)
+#define KERNEL_TOP (KERNEL_FLAGS & KF_TOP)
+#define KERNEL_HIST (KERNEL_FLAGS & KF_HIST)
+#define KERNEL_APPARENT (KERNEL_FLAGS & KF_APPARENT)
+#define KERNEL_INODES (KERNEL_FLAGS & KF_INODES)
+#define KERNEL_OWNER (KERNEL_FLAGS & KF_OWNER)
+#define KERNEL_CLOCK() ((KERNEL_RECORD || KERNEL_STATS || KERNEL_LATHIST) ? clock_ns() : 0)
+
+#define KERNEL_PASTE(a, b) a##_##b
+#define KERNEL_FUNC(name, variant) KERNEL_PASTE(name, variant)
+#define KERNEL_ENTRY KERNEL_FUNC(get_available_file_size, KERNEL_VARIANT)
+#define KERNEL_WALK KERNEL_FUNC(walk_directory, KERNEL_VARIANT)
+#define KERNEL_DIRECTORY KERNEL_FUNC(get_directory_size, KERNEL_VARIANT)
+
+/*
+*	Gets the size of a given file that is not a directory
+*
+*	@file: Struct containing the name of a file and the id of its parent.
+*	@dirent_t: The dirent struct of the current directory.
+*	@thread_id: The id of the calling thread.
+*	@readdir_ns: How long readdir took to return the entry, when recording.
+*	@lean: Where directories found in lean mode go.
+*
+*	Returns: The size of the given file.
+*
+*/
+static inline long long KERNEL_ENTRY(struct dir_info file, struct dirent *dirent_t, int thread_id,
+		long long readdir_ns, struct lean_stack *lean) {
+  struct stat file_stat;
+	char *temp;
+	long long elapsed;
+	int err;
+
+  if((strcmp(dirent_t->d_name, ".") == 0 || strcmp(dirent_t->d_name, "..") == 0)) {
+    return 0;
+  }
+
+	if((KERNEL_FLAGS & KF_EXCLUDE) && is_excluded(dirent_t->d_name)) {
+		return 0;
+	}
+
+	//Counting inodes, an entry that readdir says is not a directory is done.
+	if(KERNEL_INODES && dirent_t->d_type != DT_UNKNOWN && dirent_t->d_type != DT_DIR) {
+		if(KERNEL_STATS) {
+			thread_stats[thread_id].files++;
+		}
+		if(KERNEL_PROGRESS) {
+			progress_add(&progress[thread_id].entries, 1);
+		}
+		if(KERNEL_COUNT) {
+			count_entry(thread_id, file.parent_id);
+		}
+		return 0;
+	}
+
+  if((temp = malloc((strlen(file.name) + strlen(dirent_t->d_name) + 2) * sizeof(char))) == NULL) {
+    perror("malloc: ");
+    exit(EXIT_FAILURE);
+  }
+
+  sprintf(temp, "%s/%s", file.name, dirent_t->d_name);
+
+	//A directory is only opened when counting inodes, it needs no lstat.
+	if(KERNEL_INODES && dirent_t->d_type == DT_DIR) {
+		memset(&file_stat, 0, sizeof(file_stat));
+		file_stat.st_mode = S_IFDIR;
+		elapsed = 0;
+		err = 0;
+	}
+	else {
+		elapsed = KERNEL_CLOCK();
+		err = KERNEL_LSTAT(temp, &file_stat) < 0 ? errno : 0;
+		elapsed = KERNEL_CLOCK() - elapsed;
+		if(KERNEL_STATS) {
+			thread_stats[thread_id].stat_calls++;
+			thread_stats[thread_id].stat_ns += elapsed;
+		}
+		if(KERNEL_LATHIST) {
+			lathist_add(thread_id, OP_LSTAT, elapsed, temp);
+		}
+	}
+	PROBE4(entry__stat, thread_id, temp, err, err == 0 ? (long long)file_stat.st_blocks : 0LL);
+
+	if(err != 0) {
+		if(KERNEL_RECORD) {
+			record_entry(thread_id, dirent_t->d_type, err, NULL, 0, elapsed, readdir_ns);
+		}
+		report_error(thread_id, file.parent_id, err, "unable to stat: '%s'", temp);
+		free(temp);
+		return 0;
+	}
+	if(KERNEL_APPARENT) {
+		count_bytes(thread_id, file.parent_id, file_stat.st_size);
+	}
+	if(KERNEL_OWNER) {
+		owner_add(thread_id, file.parent_id, &file_stat);
+	}
+
+	//If the file is a directory hand it to the scheduler.
+  if(S_ISDIR(file_stat.st_mode)) {
+    struct dir_info temp_dir;
+    temp_dir.name = temp;
+    temp_dir.parent_id = file.parent_id;
+		temp_dir.trace_id = KERNEL_RECORD ? record_new_id() : 0;
+		temp_dir.node = NULL;
+		if(KERNEL_RECORD) {
+			record_entry(thread_id, dirent_t->d_type, 0, &file_stat, temp_dir.trace_id, elapsed, readdir_ns);
+		}
+		if(KERNEL_MEM) {
+			mem_count(MEM_PATHS, strlen(temp) + 1);
+			//Over --mem-limit the directory is measured by this thread instead of queued.
+			if(mem_lean()) {
+				mem_walked_inline();
+				if(KERNEL_TOP) {
+					temp_dir.node = top_new(file.node, temp);
+				}
+				lean_push(lean, temp_dir);
+				return file_stat.st_blocks;
+			}
+		}
+		if(KERNEL_PROGRESS) {
+			progress_add(&progress[thread_id].found, 1);
+		}
+		if(KERNEL_TOP) {
+			temp_dir.node = top_new(file.node, temp);
+		}
+    sched->push(thread_id, temp_dir);
+  }
+  else {
+		if(KERNEL_RECORD) {
+			record_entry(thread_id, dirent_t->d_type, 0, &file_stat, 0, elapsed, readdir_ns);
+		}
+		if(KERNEL_STATS) {
+			thread_stats[thread_id].files++;
+		}
+		if(KERNEL_PROGRESS) {
+			progress_add(&progress[thread_id].entries, 1);
+		}
+		if(KERNEL_COUNT) {
+			count_entry(thread_id, file.parent_id);
+		}
+		if(KERNEL_TOP) {
+			top_file(thread_id, file_stat.st_blocks, temp);
+		}
+		if(KERNEL_HIST) {
+			sizehist_add(thread_id, file.parent_id, file_stat.st_size, file_stat.st_blocks);
+		}
+    free(temp);
+  }
+
+  return file_stat.st_blocks;
+}
+
+/*
+*	Finds the size of the entries of one directory.
+*
+*	@file: A struct containing the name of a file and the id of that files parent.
+*	@thread_id: The id of the calling thread.
+*	@lean: Where directories found in lean mode go.
+*
+*	Returns: The size of the given directory if it could be opened and 0
+*	otherwise, without the directories put on lean.
+*
+*/
+static long long KERNEL_WALK(struct dir_info file, int thread_id, struct lean_stack *lean) {
+  long long size = 0;
+
+  KERNEL_DIR *dir_t;
+	struct dirent *dirent_t;
+  struct stat file_stat;
+	long long elapsed;
+	int err;
+
+	if(KERNEL_STATS) {
+		thread_stats[thread_id].dirs++;
+	}
+	if(KERNEL_PROGRESS) {
+		progress_add(&progress[thread_id].entries, 1);
+	}
+	if(KERNEL_COUNT) {
+		count_entry(thread_id, file.parent_id);
+	}
+
+	//If a file cannot be found, set the exit status and continue past the
+	//problematic file. Counting inodes the directory is only opened.
+	if(KERNEL_INODES) {
+		memset(&file_stat, 0, sizeof(file_stat));
+		elapsed = 0;
+		err = 0;
+	}
+	else {
+		elapsed = KERNEL_CLOCK();
+		err = KERNEL_LSTAT(file.name, &file_stat) < 0 ? errno : 0;
+		elapsed = KERNEL_CLOCK() - elapsed;
+		if(KERNEL_STATS) {
+			thread_stats[thread_id].stat_calls++;
+			thread_stats[thread_id].stat_ns += elapsed;
+		}
+		if(KERNEL_LATHIST) {
+			lathist_add(thread_id, OP_LSTAT, elapsed, file.name);
+		}
+	}
+	if(KERNEL_RECORD) {
+		record_dir_begin(thread_id, file.trace_id, err, err == 0 ? &file_stat : NULL, elapsed);
+	}
+
+  if(err != 0) {
+		if(KERNEL_RECORD) {
+			record_dir_end(thread_id, 0);
+		}
+		report_error(thread_id, file.parent_id, err, "unable to stat: '%s'", file.name);
+		if(KERNEL_MEM) {
+			mem_count(MEM_PATHS, -(long long)(strlen(file.name) + 1));
+		}
+		if(KERNEL_TOP) {
+			top_dir_done(thread_id, file.node, 0, 0);
+		}
+		else {
+			free(file.name);
+		}
+		return 0;
+  }
+
+	elapsed = KERNEL_CLOCK();
+	dir_t = KERNEL_OPENDIR(file.name);
+	err = dir_t == NULL ? errno : 0;
+	elapsed = KERNEL_CLOCK() - elapsed;
+	if(KERNEL_STATS) {
+		thread_stats[thread_id].open_calls++;
+		thread_stats[thread_id].open_ns += elapsed;
+	}
+	if(KERNEL_LATHIST) {
+		lathist_add(thread_id, OP_OPENDIR, elapsed, file.name);
+	}
+	if(KERNEL_RECORD) {
+		record_dir_open(thread_id, err, elapsed);
+	}
+
+  if(dir_t == NULL) {
+		if(KERNEL_RECORD) {
+			record_dir_end(thread_id, 0);
+		}
+		report_error(thread_id, file.parent_id, err, "du: cannot read directory '%s'", file.name);
+		if(KERNEL_MEM) {
+			mem_count(MEM_PATHS, -(long long)(strlen(file.name) + 1));
+		}
+		if(KERNEL_TOP) {
+			top_dir_done(thread_id, file.node, file_stat.st_blocks, 0);
+		}
+		else {
+			free(file.name);
+		}
+		return 0;
+	}
+
+	//Read all files in directory.
+	elapsed = KERNEL_CLOCK();
+  while((dirent_t = KERNEL_READDIR(dir_t)) != NULL) {
+		elapsed = KERNEL_CLOCK() - elapsed;
+		if(KERNEL_STATS) {
+			thread_stats[thread_id].readdir_calls++;
+			thread_stats[thread_id].readdir_ns += elapsed;
+		}
+		if(KERNEL_LATHIST) {
+			lathist_add(thread_id, OP_READDIR, elapsed, file.name);
+		}
+    size += KERNEL_ENTRY(file, dirent_t, thread_id, elapsed, lean);
+		elapsed = KERNEL_CLOCK();
+  }
+	elapsed = KERNEL_CLOCK() - elapsed;
+	if(KERNEL_STATS) {
+		thread_stats[thread_id].readdir_calls++;
+		thread_stats[thread_id].readdir_ns += elapsed;
+	}
+	if(KERNEL_LATHIST) {
+		lathist_add(thread_id, OP_READDIR, elapsed, file.name);
+	}
+
+	elapsed = KERNEL_CLOCK();
+  if(KERNEL_CLOSEDIR(dir_t) < 0) {
+		report_error(thread_id, file.parent_id, errno, "closedir error '%s'", file.name);
+  }
+	elapsed = KERNEL_CLOCK() - elapsed;
+	if(KERNEL_STATS) {
+		thread_stats[thread_id].close_calls++;
+		thread_stats[thread_id].close_ns += elapsed;
+	}
+	if(KERNEL_LATHIST) {
+		lathist_add(thread_id, OP_CLOSEDIR, elapsed, file.name);
+	}
+	if(KERNEL_RECORD) {
+		record_dir_end(thread_id, elapsed);
+	}
+
+	//The given directory has been measured and can be freed.
+	if(KERNEL_MEM) {
+		mem_count(MEM_PATHS, -(long long)(strlen(file.name) + 1));
+	}
+	if(KERNEL_TOP) {
+		top_dir_done(thread_id, file.node, file_stat.st_blocks, size);
+	}
+	else {
+		free(file.name);
+	}
+  return size;
+}
+
+/*
+*	Finds and returns the size of a directory, and of the directories below it
+*	that were found in lean mode.
+*
+*	@file: A struct containing the name of a file and the id of that files parent.
+*	@thread_id: The id of the calling thread.
+*
+*	Returns: The size of the given directory if it could be opened and 0
+*	otherwise.
+*
+*/
+static long long KERNEL_DIRECTORY(struct dir_info file, int thread_id) {
+	struct lean_stack lean = {NULL, 0, 0};
+	long long size = KERNEL_WALK(file, thread_id, &lean);
+
+	if(KERNEL_MEM) {
+		while(lean.len > 0) {
+			size += KERNEL_WALK(lean.dirs[--lean.len], thread_id, &lean);
+		}
+		lean_free(&lean);
+	}
+	return size;
+}
+
+#undef KERNEL_DIRECTORY
+#undef KERNEL_WALK
+#undef KERNEL_ENTRY
+#undef KERNEL_FUNC
+#undef KERNEL_PASTE
+#undef KERNEL_CLOCK
+#undef KERNEL_RECORD
+#undef KERNEL_STATS
+#undef KERNEL_LATHIST
+#undef KERNEL_PROGRESS
+#undef KERNEL_COUNT
+#undef KERNEL_MEM
+#undef KERNEL_TOP
+#undef KERNEL_HIST
+#undef KERNEL_APPARENT
+#undef KERNEL_INODES
+#undef KERNEL_OWNER
+#undef KERNEL_VARIANT
+#undef KERNEL_FLAGS
+#undef KERNEL_DIR
+#undef KERNEL_OPENDIR
+#undef KERNEL_READDIR
+#undef KERNEL_CLOSEDIR
+#undef KERNEL_LSTAT
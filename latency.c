@@ -0,0 +1,230 @@
+/*
+*	Filesystem backend that adds latency to another backend.
+*
+*	Every lstat and opendir waits for a delay drawn from a distribution before
+*	it is passed on, so a local disk, a synth tree or a replayed trace can
+*	stand in for slow network storage. readdir and closedir are passed on
+*	as is since network filesystems fetch a whole listing per round trip.
+*
+*	Distributions, times take an ns, us, ms or s suffix:
+*	fixed:<time>: Always the same delay.
+*	lognormal:<median>[,<sigma>]: Log-normal, sigma defaults to 0.5.
+*	pareto:<minimum>[,<alpha>]: Heavy tailed, alpha defaults to 1.5. Delays
+*															are capped at 1000 times the minimum.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "fs.h"
+
+#define PARETO_CAP 1000.0
+
+enum latency_kind {
+	LATENCY_FIXED,
+	LATENCY_LOGNORMAL,
+	LATENCY_PARETO
+};
+
+static void *latency_opendir(const char *path);
+static struct dirent *latency_readdir(void *dir);
+static int latency_closedir(void *dir);
+static int latency_lstat(const char *path, struct stat *st);
+static bool parse_time(const char *s, char **end, double *ns);
+static double uniform(void);
+static long long draw(void);
+
+const struct fs_ops latency_fs = {
+	"latency", latency_opendir, latency_readdir, latency_closedir, latency_lstat
+};
+
+//-------global variables--------
+static const struct fs_ops *inner;
+static enum latency_kind kind;
+static double scale;
+static double shape;
+static atomic_ullong next_seed = 1;
+static __thread uint64_t rng_state;
+
+/*
+*	Parses the distribution and wraps a backend.
+*
+*	@spec: The distribution, see the top of the file.
+*	@backend: The backend the calls are passed on to.
+*
+*	Returns: False if the spec is not valid.
+*
+*/
+bool latency_init(const char *spec, const struct fs_ops *backend) {
+	const char *arg = strchr(spec, ':');
+	char *end;
+
+	if(arg == NULL) {
+		return false;
+	}
+	if(strncmp(spec, "fixed:", 6) == 0) {
+		kind = LATENCY_FIXED;
+		shape = 0;
+	}
+	else if(strncmp(spec, "lognormal:", 10) == 0) {
+		kind = LATENCY_LOGNORMAL;
+		shape = 0.5;
+	}
+	else if(strncmp(spec, "pareto:", 7) == 0) {
+		kind = LATENCY_PARETO;
+		shape = 1.5;
+	}
+	else {
+		return false;
+	}
+
+	if(!parse_time(arg + 1, &end, &scale)) {
+		return false;
+	}
+	if(*end == ',' && kind != LATENCY_FIXED) {
+		shape = strtod(end + 1, &end);
+		if(shape <= 0) {
+			return false;
+		}
+	}
+	if(*end != '\0') {
+		return false;
+	}
+
+	inner = backend;
+	return true;
+}
+
+/*
+*	Parses a time with an optional unit.
+*
+*	@s: The time, such as "250us".
+*	@end: Set to the first character after the time.
+*	@ns: Where the time in nanoseconds is stored.
+*
+*	Returns: False if it is not a time.
+*
+*/
+static bool parse_time(const char *s, char **end, double *ns) {
+	static const struct {
+		const char *unit;
+		double ns;
+	} units[] = {{"ns", 1}, {"us", 1e3}, {"ms", 1e6}, {"s", 1e9}};
+
+	*ns = strtod(s, end);
+	if(*end == s || *ns < 0) {
+		return false;
+	}
+	for(size_t i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+		size_t len = strlen(units[i].unit);
+		if(strncmp(*end, units[i].unit, len) == 0) {
+			*ns *= units[i].ns;
+			*end += len;
+			break;
+		}
+	}
+	return true;
+}
+
+/*
+*	Draws a number in (0, 1) from a per-thread xorshift generator. Every
+*	thread gets its own seed the first time it draws.
+*
+*	Returns: The number.
+*
+*/
+static double uniform(void) {
+	uint64_t x;
+
+	if(rng_state == 0) {
+		rng_state = atomic_fetch_add(&next_seed, 1) * 0x9e3779b97f4a7c15ULL;
+	}
+	x = rng_state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	rng_state = x;
+	return ((x >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/*
+*	Draws a delay from the distribution.
+*
+*	Returns: The delay in nanoseconds.
+*
+*/
+static long long draw(void) {
+	double z;
+
+	switch(kind) {
+		case LATENCY_LOGNORMAL:
+		z = sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+		return scale * exp(shape * z);
+		case LATENCY_PARETO:
+		z = pow(uniform(), -1 / shape);
+		return scale * (z < PARETO_CAP ? z : PARETO_CAP);
+		default:
+		return scale;
+	}
+}
+
+/*
+*	opendir of the wrapped backend after a delay.
+*
+*	@path: The directory.
+*
+*	Returns: The handle or NULL with errno set.
+*
+*/
+static void *latency_opendir(const char *path) {
+	fs_delay(draw());
+	return inner->opendir(path);
+}
+
+/*
+*	readdir of the wrapped backend.
+*
+*	@dir: The handle.
+*
+*	Returns: The next entry or NULL at the end.
+*
+*/
+static struct dirent *latency_readdir(void *dir) {
+	return inner->readdir(dir);
+}
+
+/*
+*	closedir of the wrapped backend.
+*
+*	@dir: The handle.
+*
+*	Returns: 0 or -1 with errno set.
+*
+*/
+static int latency_closedir(void *dir) {
+	return inner->closedir(dir);
+}
+
+/*
+*	lstat of the wrapped backend after a delay.
+*
+*	@path: The file.
+*	@st: The stat struct.
+*
+*	Returns: 0 or -1 with errno set.
+*
+*/
+static int latency_lstat(const char *path, struct stat *st) {
+	fs_delay(draw());
+	return inner->lstat(path, st);
+}
@@ -0,0 +1,269 @@
+/*
+*	Latency histograms of the filesystem calls, see lathist.h.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lathist.h"
+#include "mem.h"
+
+#define SUB_BITS 5
+#define SUB_COUNT (1 << SUB_BITS)
+#define MAX_BITS 40
+#define NR_BUCKETS ((MAX_BITS - SUB_BITS + 1) * SUB_COUNT)
+
+struct slow_call {
+	long long ns;
+	char *path;
+};
+
+struct histogram {
+	long long buckets[NR_BUCKETS];
+	long long count;
+	long long max;
+	struct slow_call *slowest;
+	int nr_slowest;
+};
+
+static int bucket(long long ns);
+static long long bucket_top(int i);
+static long long quantile(const struct histogram *h, double q);
+static void keep_slow(struct histogram *h, long long ns, const char *path);
+
+//-------global variables--------
+static struct histogram (*histograms)[NR_OPS];
+static int nr_histograms;
+static int max_slowest;
+
+static const char *op_names[NR_OPS] = {"lstat", "opendir", "readdir", "closedir"};
+
+/*
+*	Allocates the histograms of every thread.
+*
+*	@thread_max: Number of threads.
+*	@slowest: How many of the slowest calls to list per kind of call.
+*
+*	Returns: Nothing.
+*
+*/
+void lathist_init(int thread_max, int slowest) {
+	nr_histograms = thread_max;
+	max_slowest = slowest;
+	if((histograms = calloc(thread_max, sizeof(*histograms))) == NULL) {
+		perror("calloc 'histograms': ");
+		exit(EXIT_FAILURE);
+	}
+	for(int i = 0; i < thread_max; i++) {
+		for(int op = 0; op < NR_OPS; op++) {
+			if((histograms[i][op].slowest = calloc(slowest + 1, sizeof(struct slow_call))) == NULL) {
+				perror("calloc 'slowest': ");
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+	mem_add(MEM_BUFFERS, thread_max * (sizeof(*histograms) + NR_OPS * (slowest + 1) * sizeof(struct slow_call)));
+}
+
+/*
+*	Finds the bucket of a latency. Values below SUB_COUNT get a bucket each,
+*	above that every power of two is split in SUB_COUNT buckets.
+*
+*	@ns: The latency.
+*
+*	Returns: The index of the bucket.
+*
+*/
+static int bucket(long long ns) {
+	int m;
+
+	if(ns < SUB_COUNT) {
+		return ns < 0 ? 0 : ns;
+	}
+	m = 63 - __builtin_clzll(ns);
+	if(m >= MAX_BITS) {
+		return NR_BUCKETS - 1;
+	}
+	return (m - SUB_BITS + 1) * SUB_COUNT + (ns >> (m - SUB_BITS)) - SUB_COUNT;
+}
+
+/*
+*	Finds the largest latency that goes in a bucket.
+*
+*	@i: The index of the bucket.
+*
+*	Returns: The latency.
+*
+*/
+static long long bucket_top(int i) {
+	int m;
+
+	if(i < SUB_COUNT) {
+		return i;
+	}
+	m = i / SUB_COUNT + SUB_BITS - 1;
+	return ((long long)(i % SUB_COUNT + SUB_COUNT + 1) << (m - SUB_BITS)) - 1;
+}
+
+/*
+*	Adds a call to the histogram of the thread.
+*
+*	@thread_id: The id of the calling thread.
+*	@op: The kind of call.
+*	@ns: How long it took.
+*	@path: The path it was made on.
+*
+*	Returns: Nothing.
+*
+*/
+void lathist_add(int thread_id, enum lathist_op op, long long ns, const char *path) {
+	struct histogram *h = &histograms[thread_id][op];
+
+	h->buckets[bucket(ns)]++;
+	h->count++;
+	if(ns > h->max) {
+		h->max = ns;
+	}
+	if(max_slowest == 0) {
+		return;
+	}
+	if(h->nr_slowest < max_slowest || ns > h->slowest[h->nr_slowest - 1].ns) {
+		keep_slow(h, ns, path);
+	}
+}
+
+/*
+*	Inserts a call in the sorted list of the slowest calls, dropping the
+*	fastest one if the list is full.
+*
+*	@h: The histogram.
+*	@ns: How long the call took.
+*	@path: The path, copied.
+*
+*	Returns: Nothing.
+*
+*/
+static void keep_slow(struct histogram *h, long long ns, const char *path) {
+	int i;
+	char *copy;
+
+	if((copy = strdup(path)) == NULL) {
+		perror("strdup: ");
+		exit(EXIT_FAILURE);
+	}
+	if(h->nr_slowest == max_slowest) {
+		free(h->slowest[--h->nr_slowest].path);
+	}
+	for(i = h->nr_slowest; i > 0 && h->slowest[i - 1].ns < ns; i--) {
+		h->slowest[i] = h->slowest[i - 1];
+	}
+	h->slowest[i].ns = ns;
+	h->slowest[i].path = copy;
+	h->nr_slowest++;
+}
+
+/*
+*	Finds a quantile of a histogram.
+*
+*	@h: The histogram.
+*	@q: The quantile, 0 to 1.
+*
+*	Returns: The top of the bucket the quantile is in, at most the maximum.
+*
+*/
+static long long quantile(const struct histogram *h, double q) {
+	long long rank = q * h->count;
+	long long seen = 0;
+
+	for(int i = 0; i < NR_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if(seen > rank) {
+			return bucket_top(i) < h->max ? bucket_top(i) : h->max;
+		}
+	}
+	return h->max;
+}
+
+/*
+*	Merges the threads and prints the quantiles and the slowest calls of
+*	every kind of call.
+*
+*	@stream: Where to print.
+*
+*	Returns: Nothing.
+*
+*/
+void print_lathist(FILE *stream) {
+	static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+	struct histogram *total;
+
+	if((total = calloc(NR_OPS, sizeof(struct histogram))) == NULL) {
+		perror("calloc 'total': ");
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(stream, "%-9s %12s %10s %10s %10s %10s %10s  (us)\n",
+		"call", "count", "p50", "p90", "p99", "p99.9", "max");
+	for(int op = 0; op < NR_OPS; op++) {
+		struct histogram *t = &total[op];
+		for(int i = 0; i < nr_histograms; i++) {
+			const struct histogram *h = &histograms[i][op];
+			for(int b = 0; b < NR_BUCKETS; b++) {
+				t->buckets[b] += h->buckets[b];
+			}
+			t->count += h->count;
+			t->max = h->max > t->max ? h->max : t->max;
+		}
+
+		fprintf(stream, "%-9s %12lld", op_names[op], t->count);
+		for(size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+			fprintf(stream, " %10.1f", quantile(t, quantiles[q]) / 1e3);
+		}
+		fprintf(stream, " %10.1f\n", t->max / 1e3);
+	}
+
+	//The slowest calls of all threads, picked from the lists of the threads.
+	for(int op = 0; op < NR_OPS && max_slowest > 0; op++) {
+		int next[nr_histograms];
+		memset(next, 0, sizeof(next));
+
+		fprintf(stream, "slowest %s:\n", op_names[op]);
+		for(int n = 0; n < max_slowest; n++) {
+			int best = -1;
+			for(int i = 0; i < nr_histograms; i++) {
+				const struct histogram *h = &histograms[i][op];
+				if(next[i] < h->nr_slowest && (best < 0 ||
+				   h->slowest[next[i]].ns > histograms[best][op].slowest[next[best]].ns)) {
+					best = i;
+				}
+			}
+			if(best < 0) {
+				break;
+			}
+			const struct slow_call *c = &histograms[best][op].slowest[next[best]++];
+			fprintf(stream, "  %10.1f  %s\n", c->ns / 1e3, c->path);
+		}
+	}
+	free(total);
+}
+
+/*
+*	Frees the histograms.
+*
+*	Returns: Nothing.
+*
+*/
+void lathist_free(void) {
+	for(int i = 0; i < nr_histograms; i++) {
+		for(int op = 0; op < NR_OPS; op++) {
+			for(int n = 0; n < histograms[i][op].nr_slowest; n++) {
+				free(histograms[i][op].slowest[n].path);
+			}
+			free(histograms[i][op].slowest);
+		}
+	}
+	free(histograms);
+}
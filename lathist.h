@@ -0,0 +1,32 @@
+/*
+*	Latency histograms of the filesystem calls for --syscall-latency.
+*
+*	Every thread keeps a log bucketed histogram per kind of call, like HDR
+*	histograms: 32 buckets per power of two so every bucket is within about
+*	3% of the values in it, from 1 ns to about 18 minutes. Each thread also
+*	keeps the slowest calls with their paths. The threads are merged when
+*	the report is printed.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef LATHIST_H
+#define LATHIST_H
+
+#include <stdio.h>
+
+enum lathist_op {
+	OP_LSTAT,
+	OP_OPENDIR,
+	OP_READDIR,
+	OP_CLOSEDIR,
+	NR_OPS
+};
+
+void lathist_init(int thread_max, int slowest);
+void lathist_add(int thread_id, enum lathist_op op, long long ns, const char *path);
+void print_lathist(FILE *stream);
+void lathist_free(void);
+
+#endif
@@ -0,0 +1,370 @@
+/*
+*	Lock contention profiling, see lockprof.h.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "lockprof.h"
+#include "stats.h"
+
+#define MAX_SITES 32
+#define MAX_HELD 4
+
+struct lock_site {
+	const char *name;
+	const char *func;
+	int line;
+	bool mutex;
+	long long acquisitions;
+	long long contended;
+	long long wait_ns;
+	long long max_wait_ns;
+	long long hold_ns;
+	long long max_hold_ns;
+};
+
+struct held_lock {
+	pthread_mutex_t *lock;
+	struct lock_site *site;
+	long long start;
+};
+
+struct lock_table {
+	struct lock_site sites[MAX_SITES];
+	int nr_sites;
+	struct held_lock held[MAX_HELD];
+	int nr_held;
+} __attribute__((aligned(64)));
+
+static struct lock_site *find_site(int thread_id, const char *name, const char *func, int line, bool mutex);
+static void count_wait(struct lock_site *site, bool contended, long long wait);
+static void merge_site(struct lock_site *into, const struct lock_site *site);
+static int compare_sites(const void *a, const void *b);
+static void print_site(FILE *stream, const char *name, const char *where, const struct lock_site *s);
+
+//-------global variables--------
+static struct lock_table *lock_tables;
+static int nr_tables;
+
+/*
+*	Allocates the lock table of every thread. Called by stats_init.
+*
+*	@thread_max: Number of threads.
+*
+*	Returns: Nothing.
+*
+*/
+void lockprof_init(int thread_max) {
+	nr_tables = thread_max;
+	if((lock_tables = aligned_alloc(64, thread_max * sizeof(struct lock_table))) == NULL) {
+		perror("aligned_alloc 'lock_tables': ");
+		exit(EXIT_FAILURE);
+	}
+	memset(lock_tables, 0, thread_max * sizeof(struct lock_table));
+}
+
+/*
+*	Finds the entry of a call site in the table of a thread, adding it the
+*	first time the site is seen.
+*
+*	@thread_id: The id of the thread.
+*	@name: Name of the lock.
+*	@func: Function of the call site.
+*	@line: Line of the call site.
+*	@mutex: True for a mutex, false for a semaphore.
+*
+*	Returns: The entry, or NULL if the table is full.
+*
+*/
+static struct lock_site *find_site(int thread_id, const char *name, const char *func, int line, bool mutex) {
+	struct lock_table *t = &lock_tables[thread_id];
+
+	for(int i = 0; i < t->nr_sites; i++) {
+		if(t->sites[i].line == line && t->sites[i].func == func && t->sites[i].name == name) {
+			return &t->sites[i];
+		}
+	}
+	if(t->nr_sites == MAX_SITES) {
+		return NULL;
+	}
+	t->sites[t->nr_sites].name = name;
+	t->sites[t->nr_sites].func = func;
+	t->sites[t->nr_sites].line = line;
+	t->sites[t->nr_sites].mutex = mutex;
+	return &t->sites[t->nr_sites++];
+}
+
+/*
+*	Counts one acquisition of a call site.
+*
+*	@site: The entry of the call site.
+*	@contended: True if the lock was taken when the thread tried.
+*	@wait: How long the thread waited.
+*
+*	Returns: Nothing.
+*
+*/
+static void count_wait(struct lock_site *site, bool contended, long long wait) {
+	site->acquisitions++;
+	site->contended += contended;
+	site->wait_ns += wait;
+	if(wait > site->max_wait_ns) {
+		site->max_wait_ns = wait;
+	}
+}
+
+/*
+*	Locks a mutex, see mutex_lock. The lock is first tried so only contended
+*	acquisitions pay for timing the wait.
+*
+*	@thread_id: The id of the calling thread.
+*	@lock: The mutex.
+*	@name: Name of the mutex.
+*	@func: Function of the call site.
+*	@line: Line of the call site.
+*
+*	Returns: Nothing.
+*
+*/
+void lockprof_lock(int thread_id, pthread_mutex_t *lock, const char *name, const char *func, int line) {
+	struct lock_table *t;
+	struct lock_site *site;
+	bool contended;
+	long long wait = 0;
+
+	if(!stats_enabled) {
+		pthread_mutex_lock(lock);
+		return;
+	}
+
+	contended = pthread_mutex_trylock(lock) != 0;
+	if(contended) {
+		wait = stats_clock();
+		pthread_mutex_lock(lock);
+		wait = stats_clock() - wait;
+	}
+
+	t = &lock_tables[thread_id];
+	if((site = find_site(thread_id, name, func, line, true)) != NULL) {
+		count_wait(site, contended, wait);
+	}
+	if(t->nr_held < MAX_HELD) {
+		t->held[t->nr_held].lock = lock;
+		t->held[t->nr_held].site = site;
+		t->held[t->nr_held].start = stats_clock();
+		t->nr_held++;
+	}
+}
+
+/*
+*	Unlocks a mutex, see mutex_unlock, and counts how long it was held at the
+*	call site that locked it.
+*
+*	@thread_id: The id of the calling thread.
+*	@lock: The mutex.
+*
+*	Returns: Nothing.
+*
+*/
+void lockprof_unlock(int thread_id, pthread_mutex_t *lock) {
+	struct lock_table *t;
+	long long hold;
+
+	if(!stats_enabled) {
+		pthread_mutex_unlock(lock);
+		return;
+	}
+
+	hold = stats_clock();
+	pthread_mutex_unlock(lock);
+
+	t = &lock_tables[thread_id];
+	for(int i = t->nr_held - 1; i >= 0; i--) {
+		if(t->held[i].lock != lock) {
+			continue;
+		}
+		hold -= t->held[i].start;
+		if(t->held[i].site != NULL) {
+			t->held[i].site->hold_ns += hold;
+			if(hold > t->held[i].site->max_hold_ns) {
+				t->held[i].site->max_hold_ns = hold;
+			}
+		}
+		t->held[i] = t->held[--t->nr_held];
+		break;
+	}
+}
+
+/*
+*	Waits on a semaphore, see semaphore_wait.
+*
+*	@thread_id: The id of the calling thread.
+*	@sem: The semaphore.
+*	@name: Name of the semaphore.
+*	@func: Function of the call site.
+*	@line: Line of the call site.
+*
+*	Returns: True if the semaphore was not available at once.
+*
+*/
+bool lockprof_wait(int thread_id, sem_t *sem, const char *name, const char *func, int line) {
+	struct lock_site *site;
+	bool contended;
+	long long wait = 0;
+
+	if(!stats_enabled) {
+		return semaphore_block(sem);
+	}
+
+	contended = sem_trywait(sem) != 0;
+	if(contended) {
+		wait = stats_clock();
+		sem_wait(sem);
+		wait = stats_clock() - wait;
+	}
+
+	if((site = find_site(thread_id, name, func, line, false)) != NULL) {
+		count_wait(site, contended, wait);
+	}
+	return contended;
+}
+
+/*
+*	Adds the counts of one call site to another.
+*
+*	@into: The entry that is added to.
+*	@site: The entry that is added.
+*
+*	Returns: Nothing.
+*
+*/
+static void merge_site(struct lock_site *into, const struct lock_site *site) {
+	into->acquisitions += site->acquisitions;
+	into->contended += site->contended;
+	into->wait_ns += site->wait_ns;
+	into->hold_ns += site->hold_ns;
+	if(site->max_wait_ns > into->max_wait_ns) {
+		into->max_wait_ns = site->max_wait_ns;
+	}
+	if(site->max_hold_ns > into->max_hold_ns) {
+		into->max_hold_ns = site->max_hold_ns;
+	}
+}
+
+/*
+*	Orders call sites by lock name and then by line.
+*
+*	@a: The first site.
+*	@b: The second site.
+*
+*	Returns: Less than, equal to or greater than zero like strcmp.
+*
+*/
+static int compare_sites(const void *a, const void *b) {
+	const struct lock_site *x = a;
+	const struct lock_site *y = b;
+	int order = strcmp(x->name, y->name);
+	return order != 0 ? order : x->line - y->line;
+}
+
+/*
+*	Prints the counts of a call site or a lock.
+*
+*	@stream: Where to print.
+*	@name: Name of the lock.
+*	@where: The call site, or "total".
+*	@s: The counts.
+*
+*	Returns: Nothing.
+*
+*/
+static void print_site(FILE *stream, const char *name, const char *where, const struct lock_site *s) {
+	//Skip the & of the expression the lock was passed as.
+	if(name[0] == '&') {
+		name++;
+	}
+	fprintf(stream, "%-16s %-20s %10lld %10lld %6.1f %9.1f %9.1f", name, where, s->acquisitions,
+		s->contended, s->acquisitions > 0 ? 100.0 * s->contended / s->acquisitions : 0.0,
+		s->wait_ns / 1e6, s->max_wait_ns / 1e3);
+	if(s->mutex) {
+		fprintf(stream, " %9.1f %9.1f\n", s->hold_ns / 1e6, s->max_hold_ns / 1e3);
+	}
+	else {
+		fprintf(stream, " %9s %9s\n", "-", "-");
+	}
+}
+
+/*
+*	Prints the merged counts of every call site followed by the total of each
+*	lock. Called by print_stats.
+*
+*	@stream: Where to print.
+*
+*	Returns: Nothing.
+*
+*/
+void print_lockprof(FILE *stream) {
+	struct lock_site sites[MAX_SITES];
+	struct lock_site total;
+	int nr_sites = 0;
+	char where[64];
+
+	//Merge the tables of the threads, every thread that passed a site has its
+	//own entry for it.
+	for(int i = 0; i < nr_tables; i++) {
+		for(int j = 0; j < lock_tables[i].nr_sites; j++) {
+			const struct lock_site *s = &lock_tables[i].sites[j];
+			int k;
+			for(k = 0; k < nr_sites; k++) {
+				if(sites[k].line == s->line && strcmp(sites[k].func, s->func) == 0 &&
+						strcmp(sites[k].name, s->name) == 0) {
+					break;
+				}
+			}
+			if(k == nr_sites) {
+				if(nr_sites == MAX_SITES) {
+					continue;
+				}
+				sites[nr_sites] = *s;
+				nr_sites++;
+			}
+			else {
+				merge_site(&sites[k], s);
+			}
+		}
+	}
+	qsort(sites, nr_sites, sizeof(struct lock_site), compare_sites);
+
+	fprintf(stream, "%-16s %-20s %10s %10s %6s %9s %9s %9s %9s\n", "lock", "site", "acquired",
+		"contended", "cont%", "wait_ms", "maxw_us", "hold_ms", "maxh_us");
+	for(int i = 0; i < nr_sites; i++) {
+		snprintf(where, sizeof(where), "%s:%d", sites[i].func, sites[i].line);
+		print_site(stream, sites[i].name, where, &sites[i]);
+
+		if(i == 0 || strcmp(sites[i].name, sites[i - 1].name) != 0) {
+			memset(&total, 0, sizeof(total));
+			total.mutex = sites[i].mutex;
+		}
+		merge_site(&total, &sites[i]);
+		if(i == nr_sites - 1 || strcmp(sites[i].name, sites[i + 1].name) != 0) {
+			print_site(stream, sites[i].name, "total", &total);
+		}
+	}
+}
+
+/*
+*	Frees the lock tables. Called by stats_free.
+*
+*	Returns: Nothing.
+*
+*/
+void lockprof_free(void) {
+	free(lock_tables);
+}
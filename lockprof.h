@@ -0,0 +1,61 @@
+/*
+*	Lock contention profiling, built with make LOCKPROF=1.
+*
+*	mdu takes its mutexes with mutex_lock and mutex_unlock and waits on its
+*	semaphores with semaphore_wait, which tells whether the caller blocked.
+*	Normally those are the pthread and POSIX functions, built with -DLOCKPROF
+*	they count every acquisition per lock and call site while --stats is
+*	given: how many there were, how many found the lock taken, the total and
+*	longest wait and, for mutexes, the total and longest hold. Like the other
+*	statistics every thread counts into its own table, the tables are merged
+*	and printed after the statistics.
+*
+*	A lock is named after the expression that was passed, so every deque of
+*	the steal scheduler counts as the one lock "d->lock".
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef LOCKPROF_H
+#define LOCKPROF_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+/*
+*	Waits on a semaphore, trying it first so the caller knows if it blocked.
+*
+*	@sem: The semaphore.
+*
+*	Returns: True if the semaphore was not available at once.
+*
+*/
+static inline bool semaphore_block(sem_t *sem) {
+	if(sem_trywait(sem) == 0) {
+		return false;
+	}
+	sem_wait(sem);
+	return true;
+}
+
+#ifdef LOCKPROF
+#define mutex_lock(thread_id, lock) lockprof_lock(thread_id, lock, #lock, __func__, __LINE__)
+#define mutex_unlock(thread_id, lock) lockprof_unlock(thread_id, lock)
+#define semaphore_wait(thread_id, sem) lockprof_wait(thread_id, sem, #sem, __func__, __LINE__)
+#else
+#define mutex_lock(thread_id, lock) ((void)(thread_id), pthread_mutex_lock(lock))
+#define mutex_unlock(thread_id, lock) ((void)(thread_id), pthread_mutex_unlock(lock))
+#define semaphore_wait(thread_id, sem) ((void)(thread_id), semaphore_block(sem))
+#endif
+
+void lockprof_init(int thread_max);
+void lockprof_lock(int thread_id, pthread_mutex_t *lock, const char *name, const char *func, int line);
+void lockprof_unlock(int thread_id, pthread_mutex_t *lock);
+bool lockprof_wait(int thread_id, sem_t *sem, const char *name, const char *func, int line);
+void print_lockprof(FILE *stream);
+void lockprof_free(void);
+
+#endif
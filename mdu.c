@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <ctype.h>
 #include <unistd.h>
 #include <stdbool.h>
@@ -21,23 +22,40 @@
 #include <dirent.h>
 #include <pthread.h>
 #include <semaphore.h>
-
-struct dir_info {
-	int parent_id;
-	char *name;
-};
+#include "sched.h"
+#include "scan.h"
+#include "report.h"
+#include "fs.h"
+#include "shape.h"
+#include "record.h"
+#include "stats.h"
+#include "trace.h"
+#include "lathist.h"
+#include "lockprof.h"
+#include "progress.h"
+#include "probes.h"
+#include "metrics.h"
+#include "mem.h"
+#include "top.h"
+#include "sizehist.h"
+#include "owner.h"
 
 struct thread_info {
 	int thread_max;
 	int thread_id;
 };
 
+//What print() shows for every given file.
+enum size_mode {
+	SIZE_BLOCKS,
+	SIZE_APPARENT,
+	SIZE_BYTES,
+	SIZE_BOTH,
+	SIZE_INODES
+};
+
 void *thread_func(void *arg);
 void run_threads(pthread_t *threads, int thread_amount);
-int get_directory_size(struct dir_info file);
-int get_available_file_size(struct dir_info file, struct dirent *dirent_t);
-struct dir_info get_available_file(void);
-void set_available_file(struct dir_info f);
 void initialize(char **argv, int thread_max);
 void initialize_files(struct dir_info dir);
 struct stat get_stat(char *file);
@@ -48,17 +66,76 @@ void free_memory(void);
 
 //----mutexes and semaphores-----
 pthread_mutex_t size_lock;
-pthread_mutex_t status_lock;
-pthread_mutex_t available_lock;
-sem_t available_sem;
 
 //-------global variables--------
-int *total_sizes;
-int nr_available_files = 0;
-int exit_status = 0;
-bool *done_threads;
-bool done;
-struct dir_info *available_files;
+long long *total_sizes;
+int nr_root_dirs = 0;
+int nr_roots = 0;
+char *record_path = NULL;
+char *latency_spec = NULL;
+char *trace_path = NULL;
+int trace_sample = 1;
+int slowest_calls = -1;
+int progress_interval = 1000;
+int progress_fd = STDERR_FILENO;
+char *metrics_path = NULL;
+int top_count = 0;
+bool histogram_enabled = false;
+enum size_mode size_mode = SIZE_BLOCKS;
+bool by_uid = false;
+bool by_gid = false;
+
+//-----------options-------------
+enum {
+	OPT_SCHEDULER = 256,
+	OPT_EXCLUDE,
+	OPT_ERROR_SUMMARY,
+	OPT_FS,
+	OPT_RECORD,
+	OPT_REPLAY_LATENCY,
+	OPT_LATENCY,
+	OPT_STATS,
+	OPT_TRACE,
+	OPT_TRACE_SAMPLE,
+	OPT_SYSCALL_LATENCY,
+	OPT_PROGRESS,
+	OPT_PROGRESS_FD,
+	OPT_METRICS_FILE,
+	OPT_MEM_LIMIT,
+	OPT_TOP,
+	OPT_HISTOGRAM,
+	OPT_APPARENT_SIZE,
+	OPT_BOTH,
+	OPT_INODES,
+	OPT_BY_UID,
+	OPT_BY_GID
+};
+
+static const struct option long_options[] = {
+	{"scheduler", required_argument, NULL, OPT_SCHEDULER},
+	{"exclude", required_argument, NULL, OPT_EXCLUDE},
+	{"error-summary", no_argument, NULL, OPT_ERROR_SUMMARY},
+	{"fs", required_argument, NULL, OPT_FS},
+	{"record", required_argument, NULL, OPT_RECORD},
+	{"replay-latency", no_argument, NULL, OPT_REPLAY_LATENCY},
+	{"latency", required_argument, NULL, OPT_LATENCY},
+	{"stats", no_argument, NULL, OPT_STATS},
+	{"trace", required_argument, NULL, OPT_TRACE},
+	{"trace-sample", required_argument, NULL, OPT_TRACE_SAMPLE},
+	{"syscall-latency", optional_argument, NULL, OPT_SYSCALL_LATENCY},
+	{"progress", optional_argument, NULL, OPT_PROGRESS},
+	{"progress-fd", required_argument, NULL, OPT_PROGRESS_FD},
+	{"metrics-file", required_argument, NULL, OPT_METRICS_FILE},
+	{"mem-limit", required_argument, NULL, OPT_MEM_LIMIT},
+	{"top", required_argument, NULL, OPT_TOP},
+	{"histogram", no_argument, NULL, OPT_HISTOGRAM},
+	{"apparent-size", no_argument, NULL, OPT_APPARENT_SIZE},
+	{"both", no_argument, NULL, OPT_BOTH},
+	{"inodes", no_argument, NULL, OPT_INODES},
+	{"by-uid", no_argument, NULL, OPT_BY_UID},
+	{"by-gid", no_argument, NULL, OPT_BY_GID},
+	{NULL, 0, NULL, 0}
+};
 
 int main(int argc, char *argv[]) {
 	char *p;
@@ -66,35 +143,225 @@ int main(int argc, char *argv[]) {
 	int opt;
 
 	int thread_amount = 1;
+	long long scan_ns;
 
   if(argc < 2) {
-    fprintf(stderr, "usage: ./mdu file [files]\n");
+    fprintf(stderr, "usage: ./mdu [-j threads] [-b] [--apparent-size] [--both] [--inodes]\n"
+		"             [--scheduler=name] [--exclude=pattern]\n"
+		"             [--error-summary] [--fs=posix|synth:spec|replay:trace]\n"
+		"             [--record=trace] [--replay-latency] [--latency=dist:time[,shape]]\n"
+		"             [--stats] [--trace=file.json] [--trace-sample=n]\n"
+		"             [--syscall-latency[=slowest]] [--progress[=ms]] [--progress-fd=fd]\n"
+		"             [--metrics-file=file] [--mem-limit=size] [--top=n] [--histogram]\n"
+		"             [--by-uid] [--by-gid] file [files]\n");
     exit(EXIT_FAILURE);
   }
 
-	//Get number of threads from user input
-	while ((opt = getopt(argc, argv, "j:")) != -1) {
+	//Get number of threads and the scheduler from user input
+	while ((opt = getopt_long(argc, argv, "j:b", long_options, NULL)) != -1) {
 		switch (opt) {
 			case 'j':
 			temp = strtol(optarg, &p, 10);
+			if(*p != '\0' || temp < 1 || temp > INT_MAX) {
+				fprintf(stderr, "invalid number of threads '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+			}
 			thread_amount = temp;
 			break;
+			case 'b':
+			size_mode = SIZE_BYTES;
+			kernel_flags |= KF_APPARENT;
+			break;
+			case OPT_APPARENT_SIZE:
+			size_mode = SIZE_APPARENT;
+			kernel_flags |= KF_APPARENT;
+			break;
+			case OPT_BOTH:
+			size_mode = SIZE_BOTH;
+			kernel_flags |= KF_APPARENT;
+			break;
+			case OPT_INODES:
+			size_mode = SIZE_INODES;
+			kernel_flags |= KF_INODES | KF_COUNT;
+			break;
+			case OPT_BY_UID:
+			by_uid = true;
+			kernel_flags |= KF_OWNER;
+			break;
+			case OPT_BY_GID:
+			by_gid = true;
+			kernel_flags |= KF_OWNER;
+			break;
+			case OPT_SCHEDULER:
+			if((sched = find_scheduler(optarg)) == NULL) {
+				fprintf(stderr, "unknown scheduler '%s', expected ", optarg);
+				list_schedulers(stderr);
+				fprintf(stderr, "\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+			case OPT_EXCLUDE:
+			add_exclude(optarg);
+			kernel_flags |= KF_EXCLUDE;
+			break;
+			case OPT_ERROR_SUMMARY:
+			error_summary = true;
+			break;
+			case OPT_FS:
+			if(!select_fs(optarg)) {
+				fprintf(stderr, "invalid filesystem '%s', expected posix, replay:trace or synth:", optarg);
+				list_shapes(stderr);
+				fprintf(stderr, "[,key=value...]\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+			case OPT_RECORD:
+			record_path = optarg;
+			kernel_flags |= KF_RECORD;
+			break;
+			case OPT_REPLAY_LATENCY:
+			replay_latency = true;
+			break;
+			case OPT_LATENCY:
+			latency_spec = optarg;
+			break;
+			case OPT_STATS:
+			stats_enabled = true;
+			kernel_flags |= KF_STATS;
+			break;
+			case OPT_TRACE:
+			trace_path = optarg;
+			break;
+			case OPT_SYSCALL_LATENCY:
+			slowest_calls = optarg == NULL ? 5 : strtol(optarg, &p, 10);
+			if(slowest_calls < 0 || (optarg != NULL && *p != '\0')) {
+				fprintf(stderr, "invalid number of slowest calls '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			kernel_flags |= KF_LATHIST;
+			break;
+			case OPT_PROGRESS:
+			if(optarg != NULL) {
+				progress_interval = strtol(optarg, &p, 10);
+				if(*p != '\0' || progress_interval < 1) {
+					fprintf(stderr, "invalid progress interval '%s'\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+			}
+			progress_enabled = true;
+			kernel_flags |= KF_PROGRESS;
+			break;
+			case OPT_PROGRESS_FD:
+			progress_fd = strtol(optarg, &p, 10);
+			if(*p != '\0' || progress_fd < 0 || fcntl(progress_fd, F_GETFD) < 0) {
+				fprintf(stderr, "invalid progress file descriptor '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+			case OPT_METRICS_FILE:
+			metrics_path = optarg;
+			kernel_flags |= KF_COUNT;
+			break;
+			case OPT_MEM_LIMIT:
+			if(!parse_size(optarg, &mem_limit)) {
+				fprintf(stderr, "invalid memory limit '%s', expected bytes or a number with K, M, G or T\n",
+					optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+			case OPT_TOP:
+			top_count = strtol(optarg, &p, 10);
+			if(*p != '\0' || top_count < 1) {
+				fprintf(stderr, "invalid number of entries '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			kernel_flags |= KF_TOP;
+			break;
+			case OPT_HISTOGRAM:
+			histogram_enabled = true;
+			kernel_flags |= KF_HIST;
+			break;
+			case OPT_TRACE_SAMPLE:
+			trace_sample = strtol(optarg, &p, 10);
+			if(*p != '\0' || trace_sample < 1) {
+				fprintf(stderr, "invalid sample rate '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+			default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	//Without lstat there are no sizes to measure or record.
+	if((kernel_flags & KF_INODES) && (kernel_flags & (KF_APPARENT | KF_TOP | KF_HIST | KF_OWNER | KF_RECORD))) {
+		fprintf(stderr, "--inodes cannot be combined with -b, --apparent-size, --both, --top,"
+			" --histogram, --by-uid, --by-gid or --record\n");
+		exit(EXIT_FAILURE);
+	}
+
+	//The delays go on top of whichever backend was selected.
+	if(latency_spec != NULL) {
+		if(!latency_init(latency_spec, fs)) {
+			fprintf(stderr, "invalid latency '%s', expected fixed:time, lognormal:median[,sigma]"
+				" or pareto:minimum[,alpha]\n", latency_spec);
+			exit(EXIT_FAILURE);
 		}
+		fs = &latency_fs;
+	}
+	if(fs != &posix_fs) {
+		kernel_flags |= KF_VFS;
 	}
+	if(stats_enabled || mem_limit > 0) {
+		mem_enabled = true;
+		kernel_flags |= KF_MEM;
+	}
+
+	//Pick the kernel once so the per-entry loop does not check the options.
+	get_directory_size = select_kernel(kernel_flags)->kernel;
 
   pthread_t threads[thread_amount];
   initialize(argv, thread_amount);
 
-  if(nr_available_files > 0) {
+	scan_ns = clock_ns();
+  if(nr_root_dirs > 0) {
 		run_threads(threads, thread_amount);
   }
+	scan_ns = clock_ns() - scan_ns;
 
   print(argv);
+	if(top_count > 0) {
+		print_top();
+	}
+	if(histogram_enabled) {
+		print_sizehist(argv + optind);
+	}
+	if(kernel_flags & KF_OWNER) {
+		print_owners(argv + optind);
+	}
+
+	report_flush(0);
+	if(error_summary) {
+		print_error_summary(argv);
+	}
+	if(stats_enabled) {
+		fflush(stdout);
+		print_stats(stderr);
+		print_mem(stderr);
+	}
+	if(slowest_calls >= 0) {
+		fflush(stdout);
+		print_lathist(stderr);
+	}
+	if(metrics_path != NULL && !write_metrics(metrics_path, argv + optind, total_sizes, nr_roots, scan_ns)) {
+		fprintf(stderr, "unable to write metrics '%s': %s\n", metrics_path, strerror(errno));
+		atomic_store(&exit_status, 1);
+	}
 
   free_memory();
 
 	//If there were errors in the threads the exit status is set to 1
-	return exit_status;
+	return atomic_load(&exit_status);
 }
 
 /*
@@ -110,6 +377,10 @@ void run_threads(pthread_t *threads, int thread_amount) {
 
 	struct thread_info thread_arg[thread_amount];
 
+	stats_scan_begin();
+	if(progress_enabled) {
+		progress_start(progress_interval, progress_fd);
+	}
 	for(int i = 0; i < thread_amount; i++) {
 
 		//Give each new thread a unique id and and pass in the total number of
@@ -124,6 +395,10 @@ void run_threads(pthread_t *threads, int thread_amount) {
 	}
 
 	join_threads(threads, thread_amount);
+	stats_scan_end();
+	if(progress_enabled) {
+		progress_stop();
+	}
 }
 
 /*
@@ -140,237 +415,103 @@ void *thread_func(void *arg) {
 
 	struct thread_info info = *(struct thread_info*) arg;
 	struct dir_info f;
-	int size;
-
-	//While loop can only be exited from inside once it is determined that all
-	//threads have finished their work.
-	while(1) {
-		//Lock the use if 'nr_available_files' and 'done' global variables then
-		//check if threads are done.
-		pthread_mutex_lock(&available_lock);
-		done_threads[info.thread_id] = true;
-		if(nr_available_files == 0) {
-			done = true;
-			for(int i = 0; i < info.thread_max; i++) {
-				if(done_threads[i] == false) {
-					done = false;
-					break;
-				}
-			}
-			//If all threads are done, signal all other threads incase one is waiting
-			//on the semaphore, and exit the loop.
-			if(done) {
-				for(int i = 0; i < info.thread_max; i++) {
-					sem_post(&available_sem);
-				}
-				pthread_mutex_unlock(&available_lock);
-				break;
-			}
-		}
-		pthread_mutex_unlock(&available_lock);
-
-		sem_wait(&available_sem);
-		//If all threads are done exit.
-		if(done) {
-			break;
-		}
+	long long size, start;
 
-		done_threads[info.thread_id] = false;
+	if(stats_enabled) {
+		stats_thread_begin(info.thread_id);
+	}
 
+	//The scheduler blocks until there is a directory to measure and returns
+	//false once all threads have finished their work.
+	while(sched->pop(info.thread_id, &f)) {
 		//Get the size of a directory.
-		f = get_available_file();
-		size = get_directory_size(f);
-		pthread_mutex_lock(&size_lock);
+		start = stats_clock();
+		PROBE2(dir__start, info.thread_id, f.name);
+		if(trace_enabled) {
+			trace_dir_begin(info.thread_id, f.name);
+		}
+		if(progress_enabled) {
+			atomic_store_explicit(&progress[info.thread_id].busy, true, memory_order_relaxed);
+		}
+		size = get_directory_size(f, info.thread_id);
+		PROBE2(dir__done, info.thread_id, size);
+		if(progress_enabled) {
+			progress_add(&progress[info.thread_id].blocks, size);
+			progress_add(&progress[info.thread_id].done, 1);
+			atomic_store_explicit(&progress[info.thread_id].busy, false, memory_order_relaxed);
+		}
+		if(trace_enabled) {
+			trace_dir_end(info.thread_id);
+		}
+		mutex_lock(info.thread_id, &size_lock);
 		total_sizes[f.parent_id] += size;
-		pthread_mutex_unlock(&size_lock);
-	}
-
-	return arg;
-}
-
-/*
-*	Finds and returns the size of a directory.
-*
-*	@file: A struct containing the name of a file and the id of that files parent.
-*
-*	Returns: The size of the given directory if it could be opened and 0
-*	otherwise.
-*
-*/
-int get_directory_size(struct dir_info file) {
-  int size = 0;
-
-  DIR *dir_t;
-	struct dirent *dirent_t;
-  struct stat file_stat;
-
-	//If a file cannot be found, set the exit status and continue past the
-	//problematic file.
-  if(lstat(file.name, &file_stat) < 0) {
-    fprintf(stderr, "unable to stat: '%s'", file.name);
-		perror("");
-		pthread_mutex_lock(&status_lock);
-		exit_status = 1;
-		pthread_mutex_unlock(&status_lock);
-		free(file.name);
-		return 0;
-  }
-
-  if((dir_t = opendir(file.name)) == NULL) {
-		fprintf(stderr, "du: cannot read directory '%s': ", file.name);
-		perror("");
-		pthread_mutex_lock(&status_lock);
-		exit_status = 1;
-		pthread_mutex_unlock(&status_lock);
-		free(file.name);
-		return 0;
-	}
-
-	//Read all files in directory.
-  while((dirent_t = readdir(dir_t)) != NULL) {
-    size += get_available_file_size(file, dirent_t);
-  }
-
-	//The given directory has been measured and can be freed.
-	free(file.name);
-
-  if(closedir(dir_t) < 0) {
-		fprintf(stderr, "closedir error: ");
-    perror("");
-		pthread_mutex_lock(&status_lock);
-		exit_status = 1;
-		pthread_mutex_unlock(&status_lock);
-  }
-  return size;
-}
-
-/*
-*	Gets the size of a given file that is not a directory
-*
-*	@file: Struct containing the name of a file and the id of its parent.
-*	@dirent_t: The dirent struct of the current directory.
-*
-*	Returns: The size of the given file.
-*
-*/
-int get_available_file_size(struct dir_info file, struct dirent *dirent_t) {
-  struct stat file_stat;
-	char *temp;
-
-  if((strcmp(dirent_t->d_name, ".") == 0 || strcmp(dirent_t->d_name, "..") == 0)) {
-    return 0;
-  }
-
-  if((temp = malloc((strlen(file.name) + strlen(dirent_t->d_name) + 2) * sizeof(char))) == NULL) {
-    perror("malloc: ");
-    exit(EXIT_FAILURE);
-  }
-
-  sprintf(temp, "%s/%s", file.name, dirent_t->d_name);
-
-	if(lstat(temp, &file_stat) < 0) {
-		fprintf(stderr, "unable to stat: '%s': ", file.name);
-		perror("");
-		pthread_mutex_lock(&status_lock);
-		exit_status = 1;
-		pthread_mutex_unlock(&status_lock);
-		free(temp);
-		return 0;
+		mutex_unlock(info.thread_id, &size_lock);
+		if(stats_enabled) {
+			thread_stats[info.thread_id].busy_ns += stats_clock() - start;
+		}
 	}
 
-	//If the file is a directory add it to the array and signal that there is a
-	//file available.
-  if(is_dir(file_stat)) {
-    struct dir_info temp_dir;
-    temp_dir.name = temp;
-    temp_dir.parent_id = file.parent_id;
-    set_available_file(temp_dir);
-		sem_post(&available_sem);
-  }
-  else {
-    free(temp);
-  }
-
-
-  return file_stat.st_blocks;
-}
-
-//What to do with the first files given.
-
-/*
-*	Gets a file struct from the global array of file structs.
-*
-*	Returns: A file struct.
-*
-*/
-struct dir_info get_available_file(void) {
-	struct dir_info f;
-	pthread_mutex_lock(&available_lock);
-	nr_available_files--;
-	f = available_files[nr_available_files];
-	pthread_mutex_unlock(&available_lock);
-
-	return(f);
-}
-
-/*
-*	Adds a file struct to the global array of file structs.
-*
-*	@f: The file struct to be put into the array.
-*
-*	Returns: Nothing if succesfull.
-*
-*/
-void set_available_file(struct dir_info f) {
-	pthread_mutex_lock(&available_lock);
-	nr_available_files++;
-	if((available_files = realloc(available_files, nr_available_files * sizeof(struct dir_info))) == NULL) {
-		perror("realloc 'available_files': ");
-		exit(EXIT_FAILURE);
+	if(stats_enabled) {
+		stats_thread_end(info.thread_id);
 	}
-	available_files[nr_available_files - 1] = f;
-	pthread_mutex_unlock(&available_lock);
+	report_flush(info.thread_id);
+	return arg;
 }
 
 /*
-*	initialize the mutexes and global variables.
+*	initialize the mutexes, the scheduler and global variables.
 *
+*	@argv: The arguments given to the program.
 *	@thread_max: The number of threads to run in the program.
 *
 *	Returns: Nothing if succesfull.
 *
 */
 void initialize(char **argv, int thread_max) {
-  if((pthread_mutex_init(&status_lock, NULL) != 0) ||
-     (pthread_mutex_init(&size_lock, NULL) != 0) ||
-     (pthread_mutex_init(&available_lock, NULL) != 0)) {
+  if(pthread_mutex_init(&size_lock, NULL) != 0) {
   	perror("pthread_mutex_init: ");
   }
 
-	if(sem_init(&available_sem, 0, 0) < 0) {
-		perror("sem_init: ");
-		exit(EXIT_FAILURE);
-	}
+	sched->init(thread_max);
 
-  if((available_files = malloc(1)) == NULL) {
-    perror("malloc 'available_files': ");
-    exit(EXIT_FAILURE);
-  }
+	while(argv[optind + nr_roots] != NULL) {
+		nr_roots++;
+	}
+	report_init(thread_max, nr_roots);
+	if(stats_enabled) {
+		stats_init(thread_max);
+	}
+	if(slowest_calls >= 0) {
+		lathist_init(thread_max, slowest_calls);
+	}
+	if(progress_enabled) {
+		progress_init(thread_max);
+	}
+	if(kernel_flags & (KF_COUNT | KF_APPARENT)) {
+		count_init(thread_max, nr_roots);
+	}
+	if(top_count > 0) {
+		top_init(thread_max, top_count);
+	}
+	if(histogram_enabled) {
+		sizehist_init(thread_max, nr_roots);
+	}
+	if(kernel_flags & KF_OWNER) {
+		owner_init(thread_max, nr_roots, by_uid, by_gid);
+	}
+	if(trace_path != NULL) {
+		trace_enabled = true;
+		trace_open(trace_path, thread_max, trace_sample);
+	}
+	if(record_path != NULL) {
+		record_open(record_path, thread_max);
+	}
 
   if((total_sizes = malloc(1)) == NULL) {
     perror("malloc 'total_sizes': ");
     exit(EXIT_FAILURE);
   }
 
-	if((done_threads = malloc(thread_max * sizeof(bool))) == NULL) {
-		perror("malloc 'done_threads': ");
-		exit(EXIT_FAILURE);
-	}
-
-	for(int i = 0; i < thread_max; i++) {
-		done_threads[i] = false;
-	}
-
 	//Add given files to the array of files.
 	int id = 0;
 	for(int i = optind; argv[i] != NULL; i++) {
@@ -382,7 +523,7 @@ void initialize(char **argv, int thread_max) {
 			exit(EXIT_FAILURE);
 		}
 
-		if((total_sizes = realloc(total_sizes, (id + 1) * sizeof(int))) == NULL) {
+		if((total_sizes = realloc(total_sizes, (id + 1) * sizeof(long long))) == NULL) {
 			perror("malloc total_sizes: ");
 			exit(EXIT_FAILURE);
 		}
@@ -390,6 +531,8 @@ void initialize(char **argv, int thread_max) {
 
 		strcpy(file.name, argv[i]);
 		file.parent_id = id;
+		file.trace_id = 0;
+		file.node = NULL;
 		initialize_files(file);
 		id++;
 	}
@@ -406,27 +549,63 @@ void initialize(char **argv, int thread_max) {
 void initialize_files(struct dir_info file) {
   struct stat file_stat;
 
-	if(lstat(file.name, &file_stat) < 0) {
-		fprintf(stderr, "unable to stat: '%s': ", file.name);
-		perror("");
-		exit_status = 1;
+	if(fs->lstat(file.name, &file_stat) < 0) {
+		int err = errno;
+		if(record_path != NULL) {
+			record_root(0, file.parent_id, file.name, err, NULL, 0);
+		}
+		report_error(0, file.parent_id, err, "unable to stat: '%s'", file.name);
+		free(file.name);
+		return;
+	}
+
+	//Recorded directories get an id so the trace can link them to their parent.
+	if(record_path != NULL) {
+		file.trace_id = is_dir(file_stat) ? record_new_id() : 0;
+		record_root(0, file.parent_id, file.name, 0, &file_stat, file.trace_id);
 	}
 
   total_sizes[file.parent_id] += file_stat.st_blocks;
+	if(progress_enabled) {
+		progress_add(&progress[0].blocks, file_stat.st_blocks);
+		progress_add(is_dir(file_stat) ? &progress[0].found : &progress[0].entries, 1);
+	}
+	//Directories are counted by the kernel that measures them.
+	if((kernel_flags & KF_COUNT) && !is_dir(file_stat)) {
+		count_entry(0, file.parent_id);
+	}
+	if(kernel_flags & KF_APPARENT) {
+		count_bytes(0, file.parent_id, file_stat.st_size);
+	}
+	if(kernel_flags & KF_OWNER) {
+		owner_add(0, file.parent_id, &file_stat);
+	}
 
 	//If it's a directory add it to the array otherwise remove it since we
 	//already have its size.
   if(is_dir(file_stat)) {
-    set_available_file(file);
-		sem_post(&available_sem);
+		mem_add(MEM_PATHS, strlen(file.name) + 1);
+		if(top_count > 0) {
+			file.node = top_new(NULL, file.name);
+		}
+    sched->push(0, file);
+		nr_root_dirs++;
   }
   else {
+		if(top_count > 0) {
+			top_file(0, file_stat.st_blocks, file.name);
+		}
+		if(histogram_enabled) {
+			sizehist_add(0, file.parent_id, file_stat.st_size, file_stat.st_blocks);
+		}
     free(file.name);
   }
 }
 
 /*
-*	Prints the array of sizes for each given file.
+*	Prints the array of sizes for each given file, the disk usage in KiB, the
+*	apparent size in KiB rounded up like du or in bytes, the disk usage
+*	followed by the apparent size in bytes, or the number of inodes.
 *
 *	@files: The array of files to have their sizes printed.
 *
@@ -436,7 +615,23 @@ void initialize_files(struct dir_info file) {
 void print(char **files) {
   int j = 0;
   for(int i = optind; files[i] != NULL; i++) {
-    printf("%d\t%s\n", total_sizes[j] / 2, files[i]);
+		switch(size_mode) {
+			case SIZE_BLOCKS:
+			printf("%lld\t%s\n", total_sizes[j] / 2, files[i]);
+			break;
+			case SIZE_APPARENT:
+			printf("%lld\t%s\n", (count_apparent(j) + 1023) / 1024, files[i]);
+			break;
+			case SIZE_BYTES:
+			printf("%lld\t%s\n", count_apparent(j), files[i]);
+			break;
+			case SIZE_BOTH:
+			printf("%lld\t%lld\t%s\n", total_sizes[j] / 2, count_apparent(j), files[i]);
+			break;
+			case SIZE_INODES:
+			printf("%lld\t%s\n", count_entries(j), files[i]);
+			break;
+		}
     j++;
   }
 }
@@ -471,21 +666,43 @@ void join_threads(pthread_t *threads, int thread_amount) {
 }
 
 /*
-*	Destroys the mutexes and frees alloced global variables.
+*	Destroys the mutexes and the scheduler and frees alloced global variables.
 *
 *	Returns: Nothing.
 *
 */
 void free_memory(void) {
-  pthread_mutex_destroy(&status_lock);
   pthread_mutex_destroy(&size_lock);
-  pthread_mutex_destroy(&available_lock);
-	if(sem_destroy(&available_sem) < 0) {
-		perror("sem_destroy: ");
-		exit(EXIT_FAILURE);
+	sched->destroy();
+	free_excludes();
+	report_free();
+	if(record_path != NULL) {
+		record_close();
+	}
+	if(stats_enabled) {
+		stats_free();
+	}
+	if(trace_enabled) {
+		trace_close();
+	}
+	if(slowest_calls >= 0) {
+		lathist_free();
+	}
+	if(progress_enabled) {
+		progress_free();
+	}
+	if(kernel_flags & (KF_COUNT | KF_APPARENT)) {
+		count_free();
+	}
+	if(top_count > 0) {
+		top_free();
+	}
+	if(histogram_enabled) {
+		sizehist_free();
+	}
+	if(kernel_flags & KF_OWNER) {
+		owner_free();
 	}
 
-	free(done_threads);
   free(total_sizes);
-  free(available_files);
 }
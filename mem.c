@@ -0,0 +1,127 @@
+/*
+*	Memory accounting for --stats and --mem-limit, see mem.h.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "mem.h"
+
+//-------global variables--------
+bool mem_enabled = false;
+long long mem_limit = 0;
+atomic_bool mem_over = false;
+
+static atomic_llong mem_current[NR_MEM];
+static atomic_llong mem_peak[NR_MEM];
+static atomic_llong mem_inline_dirs;
+static const char *mem_names[NR_MEM] = {"queue", "paths", "buffers"};
+
+/*
+*	Counts memory in a category, see mem_add, and keeps its peak. With
+*	--mem-limit it also switches lean mode on and off, from the queues and
+*	paths alone.
+*
+*	@category: What the memory is used for.
+*	@bytes: The change, negative when memory is freed.
+*
+*	Returns: Nothing.
+*
+*/
+void mem_count(enum mem_category category, long long bytes) {
+	long long now = atomic_fetch_add_explicit(&mem_current[category], bytes, memory_order_relaxed) + bytes;
+	long long peak = atomic_load_explicit(&mem_peak[category], memory_order_relaxed);
+
+	while(now > peak && !atomic_compare_exchange_weak_explicit(&mem_peak[category], &peak, now,
+			memory_order_relaxed, memory_order_relaxed)) {
+	}
+
+	//The buffers are allocated per thread at startup and do not shrink in
+	//lean mode, so only the memory that grows with the tree is limited.
+	if(mem_limit > 0 && category != MEM_BUFFERS) {
+		long long total = 0;
+		for(int i = 0; i < NR_MEM; i++) {
+			if(i != MEM_BUFFERS) {
+				total += atomic_load_explicit(&mem_current[i], memory_order_relaxed);
+			}
+		}
+		if((total >= mem_limit) != atomic_load_explicit(&mem_over, memory_order_relaxed)) {
+			atomic_store_explicit(&mem_over, total >= mem_limit, memory_order_relaxed);
+		}
+	}
+}
+
+/*
+*	Counts a directory that was walked in place because of --mem-limit.
+*
+*	Returns: Nothing.
+*
+*/
+void mem_walked_inline(void) {
+	atomic_fetch_add_explicit(&mem_inline_dirs, 1, memory_order_relaxed);
+}
+
+/*
+*	Parses a size given by the user, in bytes or with one of the suffixes
+*	K, M, G and T for powers of 1024.
+*
+*	@arg: The size.
+*	@bytes: Where the size in bytes is stored.
+*
+*	Returns: False if the size is invalid.
+*
+*/
+bool parse_size(const char *arg, long long *bytes) {
+	const char *suffixes = "KMGT";
+	char *end;
+	long long size = strtoll(arg, &end, 10);
+
+	if(end == arg || size <= 0) {
+		return false;
+	}
+	if(*end != '\0') {
+		for(int i = 0; suffixes[i] != *end; i++) {
+			if(suffixes[i] == '\0') {
+				return false;
+			}
+			size *= 1024;
+		}
+		size *= 1024;
+		if(end[1] != '\0') {
+			return false;
+		}
+	}
+	*bytes = size;
+	return true;
+}
+
+/*
+*	Prints the peak of every category and the peak RSS.
+*
+*	@stream: Where to print.
+*
+*	Returns: Nothing.
+*
+*/
+void print_mem(FILE *stream) {
+	struct rusage usage;
+
+	fprintf(stream, "memory peak:");
+	for(int i = 0; i < NR_MEM; i++) {
+		fprintf(stream, "%s %s %.1f KiB", i > 0 ? "," : "", mem_names[i], atomic_load(&mem_peak[i]) / 1024.0);
+	}
+	if(getrusage(RUSAGE_SELF, &usage) == 0) {
+		fprintf(stream, ", rss %ld KiB", usage.ru_maxrss);
+	}
+	fprintf(stream, "\n");
+	if(mem_limit > 0) {
+		fprintf(stream, "mem-limit %.1f KiB, %lld directories walked in place\n", mem_limit / 1024.0,
+			(long long)atomic_load(&mem_inline_dirs));
+	}
+}
@@ -0,0 +1,68 @@
+/*
+*	Memory accounting for --stats and --mem-limit.
+*
+*	What mdu allocates while it scans is counted per category: the queues of
+*	the schedulers, the paths of the directories that wait in them or are
+*	being measured and the nodes of --top, and the per-thread buffers. The
+*	counters are shared atomics, they change once per directory and not per
+*	entry.
+*
+*	With --mem-limit, once the queues and paths reach the limit the workers
+*	stop handing the directories they find to the scheduler and walk them
+*	depth first themselves from a stack of their own, which needs no shared
+*	queue. They go back to the scheduler when the memory drops below the
+*	limit. The per-thread buffers are fixed at startup and not limited.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef MEM_H
+#define MEM_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+enum mem_category {
+	MEM_QUEUE,
+	MEM_PATHS,
+	MEM_BUFFERS,
+	NR_MEM
+};
+
+extern bool mem_enabled;
+extern long long mem_limit;
+extern atomic_bool mem_over;
+
+void mem_count(enum mem_category category, long long bytes);
+void mem_walked_inline(void);
+bool parse_size(const char *arg, long long *bytes);
+void print_mem(FILE *stream);
+
+/*
+*	Counts memory that was allocated, or freed if bytes is negative.
+*
+*	@category: What the memory is used for.
+*	@bytes: The change.
+*
+*	Returns: Nothing.
+*
+*/
+static inline void mem_add(enum mem_category category, long long bytes) {
+	if(mem_enabled) {
+		mem_count(category, bytes);
+	}
+}
+
+/*
+*	Checks if the counted memory has reached --mem-limit.
+*
+*	Returns: True if new directories should be walked in place.
+*
+*/
+static inline bool mem_lean(void) {
+	return atomic_load_explicit(&mem_over, memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,146 @@
+/*
+*	OpenMetrics text file for --metrics-file, see metrics.h.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "metrics.h"
+#include "scan.h"
+#include "report.h"
+
+static void print_label(FILE *stream, const char *value);
+static void print_header(FILE *stream, const char *name, const char *help);
+
+/*
+*	Prints a label value, escaping what OpenMetrics requires.
+*
+*	@stream: Where to print.
+*	@value: The value.
+*
+*	Returns: Nothing.
+*
+*/
+static void print_label(FILE *stream, const char *value) {
+	fputc('"', stream);
+	for(const char *c = value; *c != '\0'; c++) {
+		if(*c == '\\' || *c == '"') {
+			fputc('\\', stream);
+			fputc(*c, stream);
+		}
+		else if(*c == '\n') {
+			fputs("\\n", stream);
+		}
+		else {
+			fputc(*c, stream);
+		}
+	}
+	fputc('"', stream);
+}
+
+/*
+*	Prints the TYPE and HELP lines of a gauge.
+*
+*	@stream: Where to print.
+*	@name: Name of the metric.
+*	@help: Description of the metric.
+*
+*	Returns: Nothing.
+*
+*/
+static void print_header(FILE *stream, const char *name, const char *help) {
+	fprintf(stream, "# TYPE %s gauge\n# HELP %s %s\n", name, name, help);
+}
+
+/*
+*	Writes the metrics of a finished scan.
+*
+*	@path: The metrics file.
+*	@roots: The files given by the user.
+*	@sizes: The size of every given file in 512 byte blocks, written in bytes.
+*					Not written with --inodes.
+*	@nr_roots: The number of given files.
+*	@scan_ns: How long the scan took.
+*
+*	Returns: False if the file could not be written, errno is then set.
+*
+*/
+bool write_metrics(const char *path, char **roots, const long long *sizes, int nr_roots,
+		long long scan_ns) {
+	struct rusage usage;
+	long long entries = 0;
+	char *temp;
+	FILE *stream;
+	bool ok;
+
+	//The temporary file has to be in the same directory for rename to be atomic.
+	if((temp = malloc(strlen(path) + 32)) == NULL) {
+		perror("malloc: ");
+		exit(EXIT_FAILURE);
+	}
+	sprintf(temp, "%s.%ld.tmp", path, (long)getpid());
+	if((stream = fopen(temp, "w")) == NULL) {
+		free(temp);
+		return false;
+	}
+
+	//Counting inodes nothing below the roots is stat'ed, so there is no size.
+	if(!(kernel_flags & KF_INODES)) {
+		print_header(stream, "mdu_root_size_bytes", "Disk usage of a given file in bytes.");
+		for(int i = 0; i < nr_roots; i++) {
+			fprintf(stream, "mdu_root_size_bytes{root=");
+			print_label(stream, roots[i]);
+			fprintf(stream, "} %lld\n", sizes[i] * 512);
+		}
+	}
+	print_header(stream, "mdu_root_inodes", "Entries in a given file, the file itself included.");
+	for(int i = 0; i < nr_roots; i++) {
+		fprintf(stream, "mdu_root_inodes{root=");
+		print_label(stream, roots[i]);
+		fprintf(stream, "} %lld\n", count_entries(i));
+		entries += count_entries(i);
+	}
+
+	print_header(stream, "mdu_scan_duration_seconds", "Time the scan took.");
+	fprintf(stream, "mdu_scan_duration_seconds %.6f\n", scan_ns / 1e9);
+	print_header(stream, "mdu_scan_entries_per_second", "Entries scanned per second.");
+	fprintf(stream, "mdu_scan_entries_per_second %.1f\n", scan_ns > 0 ? entries / (scan_ns / 1e9) : 0.0);
+
+	print_header(stream, "mdu_scan_errors", "Errors of the scan per errno.");
+	for(int e = 0; e < MAX_ERRNO; e++) {
+		long count = report_errors(e);
+		if(count > 0) {
+			const char *name = strerrorname_np(e);
+			fprintf(stream, "mdu_scan_errors{errno=\"%s\"} %ld\n", name != NULL ? name : "unknown", count);
+		}
+	}
+
+	print_header(stream, "mdu_peak_rss_bytes", "Peak resident set size of mdu.");
+	if(getrusage(RUSAGE_SELF, &usage) == 0) {
+		fprintf(stream, "mdu_peak_rss_bytes %lld\n", (long long)usage.ru_maxrss * 1024);
+	}
+	print_header(stream, "mdu_last_run_timestamp_seconds", "When the scan finished.");
+	fprintf(stream, "mdu_last_run_timestamp_seconds %lld\n", (long long)time(NULL));
+	fprintf(stream, "# EOF\n");
+
+	ok = fflush(stream) == 0 && fsync(fileno(stream)) == 0;
+	ok = fclose(stream) == 0 && ok;
+	if(!ok || rename(temp, path) < 0) {
+		int err = errno;
+		unlink(temp);
+		errno = err;
+		ok = false;
+	}
+	free(temp);
+	return ok;
+}
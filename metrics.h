@@ -0,0 +1,23 @@
+/*
+*	OpenMetrics text file for --metrics-file.
+*
+*	The file is meant for the textfile collector of the Prometheus node
+*	exporter: the size in bytes and the number of entries of every given file,
+*	how long the scan took, the entries per second, the errors per errno and
+*	the peak RSS of mdu. It is written to a temporary file in the same
+*	directory that is renamed over the old one, so the collector never reads
+*	half a file.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+
+bool write_metrics(const char *path, char **roots, const long long *sizes, int nr_roots,
+	long long scan_ns);
+
+#endif
@@ -0,0 +1,293 @@
+/*
+*	Usage per owner and group for --by-uid and --by-gid, see owner.h.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pwd.h>
+#include <grp.h>
+#include <sys/stat.h>
+#include "owner.h"
+#include "mem.h"
+
+#define OWNER_START_SIZE 16
+
+enum owner_kind {
+	OWNER_UID,
+	OWNER_GID,
+	NR_OWNER_KINDS
+};
+
+struct owner_slot {
+	long long id;
+	long long blocks;
+	long long inodes;
+};
+
+struct owner_map {
+	struct owner_slot *slots;
+	int cap;
+	int len;
+};
+
+static void map_init(struct owner_map *map, int cap);
+static void map_add(struct owner_map *map, long long id, long long blocks, long long inodes);
+static void map_grow(struct owner_map *map);
+static int compare_slots(const void *a, const void *b);
+static void print_map(const char *root, int r, enum owner_kind kind);
+
+//-------global variables--------
+static struct owner_map **maps;
+static int nr_owner_threads;
+static int nr_owner_roots;
+static bool kinds[NR_OWNER_KINDS];
+
+/*
+*	Allocates the maps of every thread.
+*
+*	@thread_max: Number of threads, the main thread uses the maps of thread 0.
+*	@nr_roots: Number of files given by the user.
+*	@by_uid: If usage per owner is kept.
+*	@by_gid: If usage per group is kept.
+*
+*	Returns: Nothing.
+*
+*/
+void owner_init(int thread_max, int nr_roots, bool by_uid, bool by_gid) {
+	//Rows are padded to whole cache lines so threads never share one.
+	size_t row = (nr_roots * NR_OWNER_KINDS * sizeof(struct owner_map) + 63) / 64 * 64;
+
+	nr_owner_threads = thread_max;
+	nr_owner_roots = nr_roots;
+	kinds[OWNER_UID] = by_uid;
+	kinds[OWNER_GID] = by_gid;
+	if((maps = malloc(thread_max * sizeof(struct owner_map *))) == NULL) {
+		perror("malloc 'maps': ");
+		exit(EXIT_FAILURE);
+	}
+	for(int i = 0; i < thread_max; i++) {
+		if((maps[i] = aligned_alloc(64, row)) == NULL) {
+			perror("aligned_alloc 'maps': ");
+			exit(EXIT_FAILURE);
+		}
+		for(int j = 0; j < nr_roots * NR_OWNER_KINDS; j++) {
+			map_init(&maps[i][j], kinds[j % NR_OWNER_KINDS] ? OWNER_START_SIZE : 0);
+		}
+	}
+}
+
+/*
+*	Allocates the slots of a map and marks them empty.
+*
+*	@map: The map.
+*	@cap: Number of slots, a power of two or 0 for a map that is not used.
+*
+*	Returns: Nothing.
+*
+*/
+static void map_init(struct owner_map *map, int cap) {
+	map->cap = cap;
+	map->len = 0;
+	map->slots = NULL;
+	if(cap == 0) {
+		return;
+	}
+	if((map->slots = malloc(cap * sizeof(struct owner_slot))) == NULL) {
+		perror("malloc 'slots': ");
+		exit(EXIT_FAILURE);
+	}
+	for(int i = 0; i < cap; i++) {
+		map->slots[i].id = -1;
+	}
+	mem_add(MEM_BUFFERS, cap * sizeof(struct owner_slot));
+}
+
+/*
+*	Adds usage to an id, inserting the id if it is new.
+*
+*	@map: The map.
+*	@id: The uid or gid.
+*	@blocks: The blocks to add.
+*	@inodes: The inodes to add.
+*
+*	Returns: Nothing.
+*
+*/
+static void map_add(struct owner_map *map, long long id, long long blocks, long long inodes) {
+	//Fibonacci hashing spreads ids that are close together, which they are.
+	unsigned int i = (unsigned int)(((unsigned long long)id * 0x9E3779B97F4A7C15ULL) >> 32) & (map->cap - 1);
+
+	while(map->slots[i].id != id) {
+		if(map->slots[i].id == -1) {
+			if(4 * (map->len + 1) > 3 * map->cap) {
+				map_grow(map);
+				map_add(map, id, blocks, inodes);
+				return;
+			}
+			map->slots[i].id = id;
+			map->slots[i].blocks = 0;
+			map->slots[i].inodes = 0;
+			map->len++;
+			break;
+		}
+		i = (i + 1) & (map->cap - 1);
+	}
+	map->slots[i].blocks += blocks;
+	map->slots[i].inodes += inodes;
+}
+
+/*
+*	Doubles the slots of a map and inserts the ids again.
+*
+*	@map: The map.
+*
+*	Returns: Nothing.
+*
+*/
+static void map_grow(struct owner_map *map) {
+	struct owner_map old = *map;
+
+	map_init(map, old.cap * 2);
+	for(int i = 0; i < old.cap; i++) {
+		if(old.slots[i].id != -1) {
+			map_add(map, old.slots[i].id, old.slots[i].blocks, old.slots[i].inodes);
+		}
+	}
+	free(old.slots);
+	mem_add(MEM_BUFFERS, -(long long)(old.cap * sizeof(struct owner_slot)));
+}
+
+/*
+*	Adds an entry to the owner and group of its root.
+*
+*	@thread_id: The id of the calling thread.
+*	@root: The id of the file given by the user.
+*	@st: The stat of the entry.
+*
+*	Returns: Nothing.
+*
+*/
+void owner_add(int thread_id, int root, const struct stat *st) {
+	struct owner_map *row = &maps[thread_id][root * NR_OWNER_KINDS];
+
+	if(kinds[OWNER_UID]) {
+		map_add(&row[OWNER_UID], st->st_uid, st->st_blocks, 1);
+	}
+	if(kinds[OWNER_GID]) {
+		map_add(&row[OWNER_GID], st->st_gid, st->st_blocks, 1);
+	}
+}
+
+/*
+*	Orders slots from the largest usage to the smallest.
+*
+*	@a: The first slot.
+*	@b: The second slot.
+*
+*	Returns: Less than, equal to or greater than zero like strcmp.
+*
+*/
+static int compare_slots(const void *a, const void *b) {
+	const struct owner_slot *x = a;
+	const struct owner_slot *y = b;
+	if(x->blocks != y->blocks) {
+		return x->blocks < y->blocks ? 1 : -1;
+	}
+	return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/*
+*	Merges the maps of every thread for a root and prints them as a table of
+*	the usage in KiB, like the totals, the inodes and the name of the owner
+*	or group, or its id if it has no name.
+*
+*	@root: The file given by the user.
+*	@r: The id of the file.
+*	@kind: Owners or groups.
+*
+*	Returns: Nothing.
+*
+*/
+static void print_map(const char *root, int r, enum owner_kind kind) {
+	struct owner_map merged;
+	int len = 0;
+
+	map_init(&merged, OWNER_START_SIZE);
+	for(int i = 0; i < nr_owner_threads; i++) {
+		struct owner_map *map = &maps[i][r * NR_OWNER_KINDS + kind];
+		for(int j = 0; j < map->cap; j++) {
+			if(map->slots[j].id != -1) {
+				map_add(&merged, map->slots[j].id, map->slots[j].blocks, map->slots[j].inodes);
+			}
+		}
+	}
+
+	//Pack the used slots to the front and sort them.
+	for(int j = 0; j < merged.cap; j++) {
+		if(merged.slots[j].id != -1) {
+			merged.slots[len++] = merged.slots[j];
+		}
+	}
+	qsort(merged.slots, len, sizeof(struct owner_slot), compare_slots);
+
+	printf("usage by %s of '%s':\n", kind == OWNER_UID ? "owner" : "group", root);
+	for(int j = 0; j < len; j++) {
+		struct owner_slot *s = &merged.slots[j];
+		const char *name = NULL;
+		if(kind == OWNER_UID) {
+			struct passwd *pw = getpwuid(s->id);
+			name = pw != NULL ? pw->pw_name : NULL;
+		}
+		else {
+			struct group *gr = getgrgid(s->id);
+			name = gr != NULL ? gr->gr_name : NULL;
+		}
+		if(name != NULL) {
+			printf("%lld\t%lld\t%s\n", s->blocks / 2, s->inodes, name);
+		}
+		else {
+			printf("%lld\t%lld\t%lld\n", s->blocks / 2, s->inodes, s->id);
+		}
+	}
+	free(merged.slots);
+	mem_add(MEM_BUFFERS, -(long long)(merged.cap * sizeof(struct owner_slot)));
+}
+
+/*
+*	Prints the tables of every root, owners before groups.
+*
+*	@roots: The files given by the user.
+*
+*	Returns: Nothing.
+*
+*/
+void print_owners(char **roots) {
+	for(int r = 0; r < nr_owner_roots; r++) {
+		for(int kind = 0; kind < NR_OWNER_KINDS; kind++) {
+			if(kinds[kind]) {
+				print_map(roots[r], r, kind);
+			}
+		}
+	}
+}
+
+/*
+*	Frees the maps.
+*
+*	Returns: Nothing.
+*
+*/
+void owner_free(void) {
+	for(int i = 0; i < nr_owner_threads; i++) {
+		for(int j = 0; j < nr_owner_roots * NR_OWNER_KINDS; j++) {
+			free(maps[i][j].slots);
+		}
+		free(maps[i]);
+	}
+	free(maps);
+}
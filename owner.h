@@ -0,0 +1,25 @@
+/*
+*	Usage per owner and group for --by-uid and --by-gid.
+*
+*	Every thread keeps one open addressing hash map per root and kind of
+*	owner, from the id to the blocks and inodes it owns. The maps use linear
+*	probing and double when they are three quarters full, so adding an entry
+*	is usually one probe into memory only that thread writes. The maps of all
+*	threads are merged when the tables are printed.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef OWNER_H
+#define OWNER_H
+
+#include <stdbool.h>
+#include <sys/stat.h>
+
+void owner_init(int thread_max, int nr_roots, bool by_uid, bool by_gid);
+void owner_add(int thread_id, int root, const struct stat *st);
+void print_owners(char **roots);
+void owner_free(void);
+
+#endif
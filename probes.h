@@ -0,0 +1,51 @@
+/*
+*	Static tracepoints (USDT) for bpftrace, perf and SystemTap.
+*
+*	A probe is a single nop in the code and a note in the binary that tools
+*	attach to at runtime, so mdu does not need to be rebuilt or print anything
+*	to be traced and costs nothing while no one is attached. Without
+*	<sys/sdt.h> (systemtap-sdt-dev) the probes compile to nothing.
+*
+*	Probes of provider mdu, the arguments are listed after the name:
+*	dir__start: thread, path. A worker starts measuring a directory.
+*	dir__done: thread, size in blocks. The directory is measured.
+*	entry__stat: thread, path, errno, size in blocks. An entry was stat:ed.
+*	work__push: thread, path. A directory is handed to the scheduler.
+*	work__pop: thread, path. A worker took a directory from the scheduler.
+*	work__steal: thread, victim. A worker stole from another worker's deque.
+*	worker__park: thread. A worker is out of work and goes to sleep.
+*	worker__wake: thread. A parked worker woke up.
+*	error: thread, errno, root. An error was reported.
+*
+*	For example the time spent per directory:
+*
+*	bpftrace -e 'usdt:./mdu:mdu:dir__start { @s[arg0] = nsecs; }
+*		usdt:./mdu:mdu:dir__done /@s[arg0]/ { @ns = hist(nsecs - @s[arg0]); }'
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef PROBES_H
+#define PROBES_H
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_SDT
+#endif
+#endif
+
+#ifdef HAVE_SDT
+#define PROBE1(name, a) DTRACE_PROBE1(mdu, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(mdu, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(mdu, name, a, b, c)
+#define PROBE4(name, a, b, c, d) DTRACE_PROBE4(mdu, name, a, b, c, d)
+#else
+#define PROBE1(name, a) ((void)(a))
+#define PROBE2(name, a, b) ((void)(a), (void)(b))
+#define PROBE3(name, a, b, c) ((void)(a), (void)(b), (void)(c))
+#define PROBE4(name, a, b, c, d) ((void)(a), (void)(b), (void)(c), (void)(d))
+#endif
+
+#endif
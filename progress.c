@@ -0,0 +1,279 @@
+/*
+*	Live progress for --progress, see progress.h.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "progress.h"
+
+//Weight of the newest interval in the smoothed drain rate.
+#define DRAIN_WEIGHT 0.2
+
+struct progress_sample {
+	long long time;
+	long long entries;
+	long long blocks;
+	long long found;
+	long long done;
+	int busy;
+};
+
+static void *progress_func(void *arg);
+static void take_sample(struct progress_sample *s);
+static void report(const struct progress_sample *s, const struct progress_sample *prev, bool last);
+static long long now_ns(void);
+
+//-------global variables--------
+bool progress_enabled = false;
+struct progress_counters *progress;
+
+static int nr_counters;
+static int out_fd;
+static bool progress_tty;
+static long long interval_ns;
+static long long start_ns;
+static double drain_rate;
+static bool stopping;
+static pthread_t reporter;
+static pthread_mutex_t stop_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond;
+
+/*
+*	Allocates the counters of every thread.
+*
+*	@thread_max: Number of threads, the main thread counts the given files into
+*							 thread 0.
+*
+*	Returns: Nothing.
+*
+*/
+void progress_init(int thread_max) {
+	nr_counters = thread_max;
+	if((progress = aligned_alloc(64, thread_max * sizeof(struct progress_counters))) == NULL) {
+		perror("aligned_alloc 'progress': ");
+		exit(EXIT_FAILURE);
+	}
+	for(int i = 0; i < thread_max; i++) {
+		atomic_init(&progress[i].entries, 0);
+		atomic_init(&progress[i].blocks, 0);
+		atomic_init(&progress[i].found, 0);
+		atomic_init(&progress[i].done, 0);
+		atomic_init(&progress[i].busy, false);
+	}
+}
+
+/*
+*	Starts the reporter thread, called when the workers are started.
+*
+*	@interval_ms: Milliseconds between two lines.
+*	@fd: Where the lines are written. A terminal gets one line that is
+*			 rewritten, anything else a line per interval.
+*
+*	Returns: Nothing.
+*
+*/
+void progress_start(int interval_ms, int fd) {
+	pthread_condattr_t attr;
+
+	out_fd = fd;
+	progress_tty = isatty(fd);
+	interval_ns = interval_ms * 1000000LL;
+	start_ns = now_ns();
+	drain_rate = 0;
+	stopping = false;
+
+	//The reporter waits on the monotonic clock so changing the time of day
+	//does not stop the reports.
+	if(pthread_condattr_init(&attr) != 0 || pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) != 0 ||
+			pthread_cond_init(&stop_cond, &attr) != 0) {
+		perror("pthread_cond_init: ");
+		exit(EXIT_FAILURE);
+	}
+	pthread_condattr_destroy(&attr);
+
+	if(pthread_create(&reporter, NULL, progress_func, NULL) != 0) {
+		perror("pthread_create: ");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+*	Stops the reporter thread once the workers are joined. It writes a last
+*	line with the final counts before it exits.
+*
+*	Returns: Nothing.
+*
+*/
+void progress_stop(void) {
+	pthread_mutex_lock(&stop_lock);
+	stopping = true;
+	pthread_cond_signal(&stop_cond);
+	pthread_mutex_unlock(&stop_lock);
+
+	if(pthread_join(reporter, NULL) != 0) {
+		fprintf(stderr, "pthread_join progress reporter\n");
+	}
+	pthread_cond_destroy(&stop_cond);
+}
+
+/*
+*	The reporter thread. Sleeps an interval at a time and reports what the
+*	workers did in it.
+*
+*	@arg: Not used.
+*
+*	Returns: NULL.
+*
+*/
+static void *progress_func(void *arg) {
+	struct progress_sample prev, cur;
+	struct timespec wake;
+	sigset_t pipe_set;
+	long long next = start_ns;
+	bool last = false;
+
+	//A reader of --progress-fd that exits makes write fail with EPIPE here
+	//instead of killing mdu. The signal is directed at this thread, so it
+	//stays pending until the thread exits.
+	sigemptyset(&pipe_set);
+	sigaddset(&pipe_set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipe_set, NULL);
+
+	memset(&prev, 0, sizeof(prev));
+	prev.time = start_ns;
+
+	while(!last) {
+		next += interval_ns;
+		wake.tv_sec = next / 1000000000LL;
+		wake.tv_nsec = next % 1000000000LL;
+
+		pthread_mutex_lock(&stop_lock);
+		while(!stopping && pthread_cond_timedwait(&stop_cond, &stop_lock, &wake) == 0) {
+		}
+		last = stopping;
+		pthread_mutex_unlock(&stop_lock);
+
+		take_sample(&cur);
+		report(&cur, &prev, last);
+		prev = cur;
+	}
+	return arg;
+}
+
+/*
+*	Sums the counters of every worker.
+*
+*	@s: Where the sums are stored.
+*
+*	Returns: Nothing.
+*
+*/
+static void take_sample(struct progress_sample *s) {
+	memset(s, 0, sizeof(*s));
+	s->time = now_ns();
+	for(int i = 0; i < nr_counters; i++) {
+		s->entries += atomic_load_explicit(&progress[i].entries, memory_order_relaxed);
+		s->blocks += atomic_load_explicit(&progress[i].blocks, memory_order_relaxed);
+		s->found += atomic_load_explicit(&progress[i].found, memory_order_relaxed);
+		s->done += atomic_load_explicit(&progress[i].done, memory_order_relaxed);
+		s->busy += atomic_load_explicit(&progress[i].busy, memory_order_relaxed);
+	}
+}
+
+/*
+*	Writes one progress line.
+*
+*	The estimate divides the waiting directories by how fast they drain,
+*	smoothed over the intervals. While the scan still finds directories faster
+*	than it measures them there is no estimate. The counters are read without
+*	synchronization, so the waiting directories are clamped at zero.
+*
+*	@s: The current sample.
+*	@prev: The sample of the previous interval.
+*	@last: True for the line written when the scan is done.
+*
+*	Returns: Nothing.
+*
+*/
+static void report(const struct progress_sample *s, const struct progress_sample *prev, bool last) {
+	static const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB", "PiB"};
+	char line[256], eta[32];
+	double seconds = (s->time - prev->time) / 1e9;
+	double bytes = s->blocks * 512.0;
+	long long pending = s->found - s->done;
+	long long prev_pending = prev->found - prev->done;
+	int unit = 0;
+	int len;
+
+	pending = pending < 0 ? 0 : pending;
+	prev_pending = prev_pending < 0 ? 0 : prev_pending;
+	if(seconds > 0) {
+		drain_rate += DRAIN_WEIGHT * ((prev_pending - pending) / seconds - drain_rate);
+	}
+
+	while(bytes >= 1024 && unit < 5) {
+		bytes /= 1024;
+		unit++;
+	}
+
+	if(last || pending == 0) {
+		snprintf(eta, sizeof(eta), "0s");
+	}
+	else if(drain_rate <= 0) {
+		snprintf(eta, sizeof(eta), "?");
+	}
+	else {
+		long long left = pending / drain_rate;
+		if(left >= 3600) {
+			snprintf(eta, sizeof(eta), "%lldh%02lldm", left / 3600, left / 60 % 60);
+		}
+		else {
+			snprintf(eta, sizeof(eta), "%lldm%02llds", left / 60, left % 60);
+		}
+	}
+
+	len = snprintf(line, sizeof(line), "%s%.1f s  %lld entries  %.0f entries/s  %.1f %s  pending %lld"
+		"  active %d/%d  eta %s%s",
+		progress_tty ? "\r\033[K" : "", (s->time - start_ns) / 1e9, s->entries,
+		seconds > 0 ? (s->entries - prev->entries) / seconds : 0.0, bytes, units[unit], pending,
+		s->busy, nr_counters, eta, progress_tty && !last ? "" : "\n");
+
+	//One write per line so readers of a pipe never see half a line. Progress
+	//is best effort, a reader that went away (EPIPE) or any other write error
+	//stops the reports but does not fail the scan.
+	if(out_fd >= 0 && write(out_fd, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1) < 0) {
+		out_fd = -1;
+	}
+}
+
+/*
+*	Reads the monotonic clock.
+*
+*	Returns: The time in nanoseconds.
+*
+*/
+static long long now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+*	Frees the counters.
+*
+*	Returns: Nothing.
+*
+*/
+void progress_free(void) {
+	free(progress);
+}
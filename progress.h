@@ -0,0 +1,53 @@
+/*
+*	Live progress for --progress.
+*
+*	Every worker counts into its own cache line aligned counters with relaxed
+*	atomic stores, only the worker writes its counters so there are no locks
+*	or read-modify-write instructions. A reporter thread sums the counters of
+*	all workers every interval and writes a line with the entries per second,
+*	the bytes counted, the directories that are waiting in the scheduler, the
+*	busy workers and an estimate of the time left from how fast the waiting
+*	directories drain.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+struct progress_counters {
+	atomic_llong entries;
+	atomic_llong blocks;
+	atomic_llong found;
+	atomic_llong done;
+	atomic_bool busy;
+} __attribute__((aligned(64)));
+
+extern bool progress_enabled;
+extern struct progress_counters *progress;
+
+void progress_init(int thread_max);
+void progress_start(int interval_ms, int fd);
+void progress_stop(void);
+void progress_free(void);
+
+/*
+*	Adds to a counter of the calling thread. Only the owner writes a counter
+*	so a relaxed load and store is enough.
+*
+*	@counter: The counter.
+*	@n: What to add.
+*
+*	Returns: Nothing.
+*
+*/
+static inline void progress_add(atomic_llong *counter, long long n) {
+	atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+		memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,356 @@
+/*
+*	Recording of scans for the replay backend, see record.h for the format.
+*
+*	Every thread builds the records of the directories it measures in its own
+*	buffer and appends the buffer to the trace under a lock once it is large,
+*	so the lock is taken about once per megabyte of trace.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "record.h"
+#include "mem.h"
+
+#define RECORD_FLUSH_SIZE (1024 * 1024)
+
+struct buffer {
+	uint8_t *data;
+	size_t len;
+	size_t cap;
+};
+
+struct recorder {
+	struct buffer out;
+	struct buffer head;
+	struct buffer entries;
+	uint64_t nr_entries;
+	bool opened;
+};
+
+static void put(struct buffer *b, const void *data, size_t len);
+static void put_number(struct buffer *b, uint64_t value);
+static void put_stat(struct buffer *b, int err, const struct stat *st);
+
+static FILE *trace;
+static pthread_mutex_t trace_lock;
+static struct recorder *recorders;
+static int nr_recorders;
+static atomic_uint next_id;
+
+/*
+*	Creates the trace and one recorder per thread.
+*
+*	@path: The file to write the trace to.
+*	@thread_max: Number of threads, the main thread uses the recorder of
+*							 thread 0.
+*
+*	Returns: Nothing.
+*
+*/
+void record_open(const char *path, int thread_max) {
+	if((trace = fopen(path, "wb")) == NULL) {
+		fprintf(stderr, "cannot create trace '%s': ", path);
+		perror("");
+		exit(EXIT_FAILURE);
+	}
+	fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LEN, trace);
+
+	if(pthread_mutex_init(&trace_lock, NULL) != 0) {
+		perror("pthread_mutex_init: ");
+	}
+	if((recorders = calloc(thread_max, sizeof(struct recorder))) == NULL) {
+		perror("calloc 'recorders': ");
+		exit(EXIT_FAILURE);
+	}
+	nr_recorders = thread_max;
+	atomic_store(&next_id, 0);
+}
+
+/*
+*	Hands out the id of a newly found directory.
+*
+*	Returns: The id.
+*
+*/
+unsigned int record_new_id(void) {
+	return atomic_fetch_add_explicit(&next_id, 1, memory_order_relaxed);
+}
+
+/*
+*	Records a file given by the user.
+*
+*	@thread_id: The id of the calling thread.
+*	@root: The index of the file among the given files.
+*	@name: The path as given by the user.
+*	@err: The errno of lstat, or 0.
+*	@st: The stat of the file.
+*	@id: The directory id if the file is a directory.
+*
+*	Returns: Nothing.
+*
+*/
+void record_root(int thread_id, int root, const char *name, int err, const struct stat *st, unsigned int id) {
+	struct buffer *b = &recorders[thread_id].out;
+	size_t len = strlen(name);
+
+	put(b, "R", 1);
+	put_number(b, root);
+	put_number(b, len);
+	put(b, name, len);
+	put_stat(b, err, st);
+	if(err == 0 && S_ISDIR(st->st_mode)) {
+		put_number(b, id);
+	}
+}
+
+/*
+*	Starts the record of a directory.
+*
+*	@thread_id: The id of the calling thread.
+*	@id: The id of the directory.
+*	@err: The errno of lstat on the directory, or 0.
+*	@st: The stat of the directory.
+*	@lstat_ns: How long lstat took.
+*
+*	Returns: Nothing.
+*
+*/
+void record_dir_begin(int thread_id, unsigned int id, int err, const struct stat *st, long long lstat_ns) {
+	struct recorder *r = &recorders[thread_id];
+
+	r->head.len = 0;
+	r->entries.len = 0;
+	r->nr_entries = 0;
+	r->opened = false;
+	put(&r->head, "D", 1);
+	put_number(&r->head, id);
+	put_stat(&r->head, err, st);
+	put_number(&r->head, lstat_ns);
+}
+
+/*
+*	Records the result of opening the directory.
+*
+*	@thread_id: The id of the calling thread.
+*	@err: The errno of opendir, or 0.
+*	@opendir_ns: How long opendir took.
+*
+*	Returns: Nothing.
+*
+*/
+void record_dir_open(int thread_id, int err, long long opendir_ns) {
+	struct recorder *r = &recorders[thread_id];
+
+	put_number(&r->head, err);
+	put_number(&r->head, opendir_ns);
+	r->opened = true;
+}
+
+/*
+*	Records an entry of the directory.
+*
+*	@thread_id: The id of the calling thread.
+*	@d_type: The type readdir gave the entry.
+*	@err: The errno of lstat, or 0.
+*	@st: The stat of the entry.
+*	@child: The id of the entry if it is a directory.
+*	@lstat_ns: How long lstat took.
+*	@readdir_ns: How long readdir took to return the entry.
+*
+*	Returns: Nothing.
+*
+*/
+void record_entry(int thread_id, unsigned char d_type, int err, const struct stat *st,
+		unsigned int child, long long lstat_ns, long long readdir_ns) {
+	struct buffer *b = &recorders[thread_id].entries;
+
+	put(b, &d_type, 1);
+	put_stat(b, err, st);
+	if(err == 0 && S_ISDIR(st->st_mode)) {
+		put_number(b, child);
+	}
+	put_number(b, lstat_ns);
+	put_number(b, readdir_ns);
+	recorders[thread_id].nr_entries++;
+}
+
+/*
+*	Finishes the record of a directory and moves it to the output buffer of
+*	the thread.
+*
+*	@thread_id: The id of the calling thread.
+*	@closedir_ns: How long closedir took.
+*
+*	Returns: Nothing.
+*
+*/
+void record_dir_end(int thread_id, long long closedir_ns) {
+	struct recorder *r = &recorders[thread_id];
+
+	if(!r->opened) {
+		record_dir_open(thread_id, 0, 0);
+	}
+	put_number(&r->head, closedir_ns);
+	put_number(&r->head, r->nr_entries);
+	put(&r->out, r->head.data, r->head.len);
+	put(&r->out, r->entries.data, r->entries.len);
+
+	if(r->out.len >= RECORD_FLUSH_SIZE) {
+		record_flush(thread_id);
+	}
+}
+
+/*
+*	Appends the output buffer of a thread to the trace.
+*
+*	@thread_id: The id of the thread.
+*
+*	Returns: Nothing.
+*
+*/
+void record_flush(int thread_id) {
+	struct buffer *b = &recorders[thread_id].out;
+
+	pthread_mutex_lock(&trace_lock);
+	if(fwrite(b->data, 1, b->len, trace) != b->len) {
+		perror("fwrite trace: ");
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_unlock(&trace_lock);
+	b->len = 0;
+}
+
+/*
+*	Writes what is left in the buffers and closes the trace.
+*
+*	Returns: Nothing.
+*
+*/
+void record_close(void) {
+	for(int i = 0; i < nr_recorders; i++) {
+		record_flush(i);
+		free(recorders[i].out.data);
+		free(recorders[i].head.data);
+		free(recorders[i].entries.data);
+	}
+	free(recorders);
+	if(fclose(trace) != 0) {
+		perror("fclose trace: ");
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_destroy(&trace_lock);
+}
+
+/*
+*	Appends bytes to a buffer, growing it as needed.
+*
+*	@b: The buffer.
+*	@data: The bytes.
+*	@len: Number of bytes.
+*
+*	Returns: Nothing.
+*
+*/
+static void put(struct buffer *b, const void *data, size_t len) {
+	if(b->len + len > b->cap) {
+		mem_add(MEM_BUFFERS, -(long long)b->cap);
+		b->cap = b->cap == 0 ? 4096 : b->cap * 2;
+		if(b->cap < b->len + len) {
+			b->cap = b->len + len;
+		}
+		if((b->data = realloc(b->data, b->cap)) == NULL) {
+			perror("realloc 'trace buffer': ");
+			exit(EXIT_FAILURE);
+		}
+		mem_add(MEM_BUFFERS, b->cap);
+	}
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+/*
+*	Appends a varint to a buffer.
+*
+*	@b: The buffer.
+*	@value: The number.
+*
+*	Returns: Nothing.
+*
+*/
+static void put_number(struct buffer *b, uint64_t value) {
+	uint8_t tmp[10];
+	put(b, tmp, put_varint(tmp, value));
+}
+
+/*
+*	Appends the errno of a stat call and, if it succeeded, the type, blocks
+*	and size.
+*
+*	@b: The buffer.
+*	@err: The errno, or 0.
+*	@st: The stat.
+*
+*	Returns: Nothing.
+*
+*/
+static void put_stat(struct buffer *b, int err, const struct stat *st) {
+	put_number(b, err);
+	if(err == 0) {
+		uint8_t type = IFTODT(st->st_mode);
+		put(b, &type, 1);
+		put_number(b, st->st_blocks);
+		put_number(b, st->st_size);
+	}
+}
+
+/*
+*	Encodes a number as an unsigned LEB128 varint.
+*
+*	@buf: Where to write, at least 10 bytes.
+*	@value: The number.
+*
+*	Returns: Number of bytes written.
+*
+*/
+size_t put_varint(uint8_t *buf, uint64_t value) {
+	size_t n = 0;
+	while(value >= 0x80) {
+		buf[n++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	buf[n++] = value;
+	return n;
+}
+
+/*
+*	Decodes an unsigned LEB128 varint.
+*
+*	@buf: Where to read.
+*	@end: End of the readable memory.
+*	@value: Where the number is stored.
+*
+*	Returns: The byte after the varint or NULL if it runs past end.
+*
+*/
+const uint8_t *get_varint(const uint8_t *buf, const uint8_t *end, uint64_t *value) {
+	*value = 0;
+	for(int shift = 0; buf < end && shift < 64; shift += 7) {
+		uint8_t b = *buf++;
+		*value |= (uint64_t)(b & 0x7f) << shift;
+		if((b & 0x80) == 0) {
+			return buf;
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,49 @@
+/*
+*	Recording of scans for the replay backend.
+*
+*	--record=file writes the shape of everything the scan sees to a compact
+*	binary trace: for every directory its stat, the type, size and blocks of
+*	every entry and how long each call took. Names are not recorded, only the
+*	paths of the given files, so traces of private trees can be shared.
+*
+*	The trace is a magic string followed by records, all numbers are unsigned
+*	LEB128 varints:
+*
+*	'R' root_index name_len name stat
+*	'D' dir_id stat lstat_ns open_errno opendir_ns closedir_ns nr_entries entry...
+*
+*	where stat is errno, followed by type blocks size if errno is 0, and entry
+*	is d_type stat [child_dir_id if a directory] lstat_ns readdir_ns. Directory
+*	ids are handed out as directories are found, records are written as they
+*	are finished, so they are in no particular order.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define TRACE_MAGIC "MDUTRACE1\n"
+#define TRACE_MAGIC_LEN 10
+
+void record_open(const char *path, int thread_max);
+unsigned int record_new_id(void);
+void record_root(int thread_id, int root, const char *name, int err, const struct stat *st, unsigned int id);
+void record_dir_begin(int thread_id, unsigned int id, int err, const struct stat *st, long long lstat_ns);
+void record_dir_open(int thread_id, int err, long long opendir_ns);
+void record_entry(int thread_id, unsigned char d_type, int err, const struct stat *st,
+	unsigned int child, long long lstat_ns, long long readdir_ns);
+void record_dir_end(int thread_id, long long closedir_ns);
+void record_flush(int thread_id);
+void record_close(void);
+
+size_t put_varint(uint8_t *buf, uint64_t value);
+const uint8_t *get_varint(const uint8_t *buf, const uint8_t *end, uint64_t *value);
+
+#endif
@@ -0,0 +1,452 @@
+/*
+*	Filesystem backend that replays a trace written with --record.
+*
+*	The trace is mapped into memory and indexed by directory id once. Entries
+*	are named after where they are in the trace, "d.<offset>" for directories
+*	and "f.<offset>" for everything else, so lstat finds an entry straight from
+*	its path. The given files are matched by name against the recorded roots,
+*	a trace with a single root matches any name.
+*
+*	With --replay-latency every call takes as long as it did when the trace
+*	was recorded.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "fs.h"
+#include "record.h"
+
+struct replay_root {
+	char *name;
+	const uint8_t *stat;
+	uint64_t dir;
+};
+
+struct replay_dir {
+	const uint8_t *pos;
+	uint64_t left;
+	int dots;
+	uint64_t closedir_ns;
+	struct dirent entry;
+};
+
+struct trace_stat {
+	uint64_t err;
+	uint8_t type;
+	uint64_t blocks;
+	uint64_t size;
+};
+
+static void *replay_opendir(const char *path);
+static struct dirent *replay_readdir(void *dir);
+static int replay_closedir(void *dir);
+static int replay_lstat(const char *path, struct stat *st);
+static bool index_trace(void);
+static const uint8_t *read_number(const uint8_t *p, uint64_t *value);
+static const uint8_t *read_stat(const uint8_t *p, struct trace_stat *ts);
+static const uint8_t *skip_entry(const uint8_t *p);
+static const uint8_t *find(const char *path, int *root);
+static void fill_stat(const struct trace_stat *ts, const uint8_t *where, struct stat *st);
+
+const struct fs_ops replay_fs = {
+	"replay", replay_opendir, replay_readdir, replay_closedir, replay_lstat
+};
+
+//-------global variables--------
+bool replay_latency = false;
+
+static const uint8_t *trace_data;
+static const uint8_t *trace_end;
+static const uint8_t **dirs;
+static uint64_t nr_dirs;
+static struct replay_root *roots;
+static int nr_roots;
+
+/*
+*	Maps a trace into memory and indexes it.
+*
+*	@path: The trace.
+*
+*	Returns: False if the trace cannot be read or is not a valid trace.
+*
+*/
+bool replay_init(const char *path) {
+	struct stat st;
+	int fd;
+	void *data;
+
+	if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "cannot read trace '%s': ", path);
+		perror("");
+		return false;
+	}
+	if(st.st_size < TRACE_MAGIC_LEN ||
+	   (data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		fprintf(stderr, "'%s' is not a trace\n", path);
+		close(fd);
+		return false;
+	}
+	close(fd);
+
+	trace_data = data;
+	trace_end = trace_data + st.st_size;
+	if(memcmp(trace_data, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0 || !index_trace()) {
+		fprintf(stderr, "'%s' is not a trace\n", path);
+		return false;
+	}
+	return true;
+}
+
+/*
+*	Reads all records of the trace, remembering where every directory record
+*	is and the recorded roots.
+*
+*	Returns: False if the trace is truncated or has an unknown record.
+*
+*/
+static bool index_trace(void) {
+	const uint8_t *p = trace_data + TRACE_MAGIC_LEN;
+	uint64_t cap = 0;
+
+	while(p != NULL && p < trace_end) {
+		uint8_t tag = *p++;
+		uint64_t id, len, n, skip;
+		struct trace_stat ts;
+
+		if(tag == 'R') {
+			struct replay_root root;
+			if((p = read_number(p, &id)) == NULL || (p = read_number(p, &len)) == NULL ||
+			   len > (uint64_t)(trace_end - p)) {
+				return false;
+			}
+			if((root.name = strndup((const char *)p, len)) == NULL) {
+				perror("strndup: ");
+				exit(EXIT_FAILURE);
+			}
+			root.stat = p + len;
+			root.dir = UINT64_MAX;
+			p = read_stat(p + len, &ts);
+			if(p != NULL && ts.err == 0 && ts.type == DT_DIR) {
+				p = read_number(p, &root.dir);
+			}
+			if((roots = realloc(roots, (nr_roots + 1) * sizeof(struct replay_root))) == NULL) {
+				perror("realloc 'roots': ");
+				exit(EXIT_FAILURE);
+			}
+			roots[nr_roots++] = root;
+		}
+		else if(tag == 'D') {
+			if((p = read_number(p, &id)) == NULL) {
+				return false;
+			}
+			if(id >= cap) {
+				uint64_t old = cap;
+				cap = id + 1 > cap * 2 ? id + 1 : cap * 2;
+				if((dirs = realloc(dirs, cap * sizeof(uint8_t *))) == NULL) {
+					perror("realloc 'dirs': ");
+					exit(EXIT_FAILURE);
+				}
+				memset(dirs + old, 0, (cap - old) * sizeof(uint8_t *));
+			}
+			dirs[id] = p;
+			if(id >= nr_dirs) {
+				nr_dirs = id + 1;
+			}
+
+			//stat, lstat_ns, open_errno, opendir_ns, closedir_ns, nr_entries
+			p = read_stat(p, &ts);
+			for(int i = 0; i < 4 && p != NULL; i++) {
+				p = read_number(p, &skip);
+			}
+			if(p == NULL || (p = read_number(p, &n)) == NULL) {
+				return false;
+			}
+			for(uint64_t i = 0; i < n && p != NULL; i++) {
+				p = skip_entry(p);
+			}
+		}
+		else {
+			return false;
+		}
+	}
+	return p != NULL;
+}
+
+/*
+*	Reads a varint from the trace.
+*
+*	@p: Where to read.
+*	@value: Where the number is stored.
+*
+*	Returns: The byte after the number or NULL if the trace ends first.
+*
+*/
+static const uint8_t *read_number(const uint8_t *p, uint64_t *value) {
+	return p == NULL ? NULL : get_varint(p, trace_end, value);
+}
+
+/*
+*	Reads the errno, type, blocks and size of a recorded stat.
+*
+*	@p: Where to read.
+*	@ts: Where the stat is stored.
+*
+*	Returns: The byte after the stat or NULL if the trace ends first.
+*
+*/
+static const uint8_t *read_stat(const uint8_t *p, struct trace_stat *ts) {
+	ts->type = DT_UNKNOWN;
+	if((p = read_number(p, &ts->err)) == NULL || ts->err != 0) {
+		return p;
+	}
+	if(p >= trace_end) {
+		return NULL;
+	}
+	ts->type = *p++;
+	p = read_number(p, &ts->blocks);
+	return read_number(p, &ts->size);
+}
+
+/*
+*	Skips an entry of a directory record.
+*
+*	@p: The start of the entry.
+*
+*	Returns: The start of the next entry or NULL if the trace ends first.
+*
+*/
+static const uint8_t *skip_entry(const uint8_t *p) {
+	struct trace_stat ts;
+	uint64_t skip;
+
+	if(p >= trace_end) {
+		return NULL;
+	}
+	p = read_stat(p + 1, &ts);
+	if(p != NULL && ts.err == 0 && ts.type == DT_DIR) {
+		p = read_number(p, &skip);
+	}
+	p = read_number(p, &skip);
+	return read_number(p, &skip);
+}
+
+/*
+*	Finds the entry or root a path refers to.
+*
+*	@path: The path.
+*	@root: Set to the index of the root the path is, or -1 for an entry.
+*
+*	Returns: The recorded stat of the entry or root, NULL if there is none.
+*
+*/
+static const uint8_t *find(const char *path, int *root) {
+	const char *name = strrchr(path, '/');
+	char *end;
+
+	name = name == NULL ? path : name + 1;
+	*root = -1;
+	if((name[0] == 'd' || name[0] == 'f') && name[1] == '.') {
+		unsigned long long off = strtoull(name + 2, &end, 16);
+		if(*end == '\0' && off > TRACE_MAGIC_LEN && off < (unsigned long long)(trace_end - trace_data)) {
+			//Entries start with their d_type.
+			return trace_data + off + 1;
+		}
+	}
+
+	for(int i = 0; i < nr_roots; i++) {
+		if(strcmp(roots[i].name, path) == 0) {
+			*root = i;
+			return roots[i].stat;
+		}
+	}
+	if(nr_roots == 1) {
+		*root = 0;
+		return roots[0].stat;
+	}
+	return NULL;
+}
+
+/*
+*	Fills in a stat struct from a recorded stat.
+*
+*	@ts: The recorded stat.
+*	@where: Where in the trace it is, used as inode number.
+*	@st: The stat struct.
+*
+*	Returns: Nothing.
+*
+*/
+static void fill_stat(const struct trace_stat *ts, const uint8_t *where, struct stat *st) {
+	memset(st, 0, sizeof(struct stat));
+	st->st_mode = DTTOIF(ts->type) | (ts->type == DT_DIR ? 0755 : 0644);
+	st->st_ino = where - trace_data;
+	st->st_nlink = 1;
+	st->st_blocks = ts->blocks;
+	st->st_size = ts->size;
+	st->st_blksize = 4096;
+}
+
+/*
+*	Returns the recorded stat of a path, after the recorded latency.
+*
+*	@path: The path.
+*	@st: The stat struct.
+*
+*	Returns: 0, or -1 with the recorded errno.
+*
+*/
+static int replay_lstat(const char *path, struct stat *st) {
+	struct trace_stat ts;
+	const uint8_t *p;
+	uint64_t skip, lstat_ns;
+	int root;
+
+	if((p = find(path, &root)) == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	p = read_stat(p, &ts);
+	if(root < 0 && replay_latency) {
+		if(ts.err == 0 && ts.type == DT_DIR) {
+			p = read_number(p, &skip);
+		}
+		read_number(p, &lstat_ns);
+		fs_delay(lstat_ns);
+	}
+	if(ts.err != 0) {
+		errno = ts.err;
+		return -1;
+	}
+	fill_stat(&ts, p, st);
+	return 0;
+}
+
+/*
+*	Opens a recorded directory, after the recorded latency.
+*
+*	@path: The directory.
+*
+*	Returns: The handle, or NULL with the recorded errno.
+*
+*/
+static void *replay_opendir(const char *path) {
+	struct replay_dir *dir;
+	struct trace_stat ts;
+	const uint8_t *p;
+	uint64_t id, skip, open_err, opendir_ns;
+	int root;
+
+	if((p = find(path, &root)) == NULL) {
+		errno = ENOENT;
+		return NULL;
+	}
+	p = read_stat(p, &ts);
+	if(ts.err != 0 || ts.type != DT_DIR) {
+		errno = ts.err != 0 ? (int)ts.err : ENOTDIR;
+		return NULL;
+	}
+	if(root >= 0) {
+		id = roots[root].dir;
+	}
+	else {
+		read_number(p, &id);
+	}
+	if(id >= nr_dirs || dirs[id] == NULL) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	p = read_stat(dirs[id], &ts);
+	p = read_number(p, &skip);
+	p = read_number(p, &open_err);
+	p = read_number(p, &opendir_ns);
+	if(replay_latency) {
+		fs_delay(opendir_ns);
+	}
+	if(open_err != 0) {
+		errno = open_err;
+		return NULL;
+	}
+
+	if((dir = malloc(sizeof(struct replay_dir))) == NULL) {
+		return NULL;
+	}
+	p = read_number(p, &dir->closedir_ns);
+	dir->pos = read_number(p, &dir->left);
+	dir->dots = 0;
+	return dir;
+}
+
+/*
+*	Reads the next entry: ".", ".." and then the recorded entries.
+*
+*	@dir: The handle.
+*
+*	Returns: The entry or NULL at the end of the directory.
+*
+*/
+static struct dirent *replay_readdir(void *dir) {
+	struct replay_dir *d = dir;
+	struct trace_stat ts;
+	const uint8_t *start = d->pos;
+	const uint8_t *p;
+	uint64_t skip, readdir_ns;
+
+	if(d->dots < 2) {
+		strcpy(d->entry.d_name, d->dots == 0 ? "." : "..");
+		d->entry.d_type = DT_DIR;
+		d->dots++;
+		return &d->entry;
+	}
+	if(d->left == 0) {
+		return NULL;
+	}
+
+	d->entry.d_type = *start;
+	p = read_stat(start + 1, &ts);
+	if(ts.err == 0 && ts.type == DT_DIR) {
+		p = read_number(p, &skip);
+	}
+	p = read_number(p, &skip);
+	d->pos = read_number(p, &readdir_ns);
+	d->left--;
+
+	if(replay_latency) {
+		fs_delay(readdir_ns);
+	}
+	snprintf(d->entry.d_name, sizeof(d->entry.d_name), "%c.%lx",
+		ts.err == 0 && ts.type == DT_DIR ? 'd' : 'f', (unsigned long)(start - trace_data));
+	d->entry.d_ino = start - trace_data;
+	return &d->entry;
+}
+
+/*
+*	Closes a directory, after the recorded latency.
+*
+*	@dir: The handle.
+*
+*	Returns: 0.
+*
+*/
+static int replay_closedir(void *dir) {
+	struct replay_dir *d = dir;
+
+	if(replay_latency) {
+		fs_delay(d->closedir_ns);
+	}
+	free(d);
+	return 0;
+}
@@ -0,0 +1,220 @@
+/*
+*	Buffered error reporting for mdu.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "report.h"
+#include "probes.h"
+#include "mem.h"
+
+#define REPORT_BUF_SIZE (64 * 1024)
+#define REPORT_MSG_MAX 4096
+
+struct report_buffer {
+	char *buf;
+	size_t len;
+	long *errno_counts;
+	long *root_counts;
+};
+
+static void write_all(const char *buf, size_t len);
+
+//-------global variables--------
+atomic_int exit_status = 0;
+bool error_summary = false;
+
+static struct report_buffer *buffers;
+static int nr_buffers;
+static int nr_report_roots;
+
+/*
+*	Allocates one buffer and one set of counters per thread.
+*
+*	@thread_max: Number of threads, the main thread shares the buffer of
+*							 thread 0 since they never run at the same time.
+*	@nr_roots: Number of files given by the user.
+*
+*	Returns: Nothing.
+*
+*/
+void report_init(int thread_max, int nr_roots) {
+	nr_buffers = thread_max;
+	nr_report_roots = nr_roots;
+
+	if((buffers = calloc(thread_max, sizeof(struct report_buffer))) == NULL) {
+		perror("calloc 'buffers': ");
+		exit(EXIT_FAILURE);
+	}
+
+	for(int i = 0; i < thread_max; i++) {
+		if(((buffers[i].buf = malloc(REPORT_BUF_SIZE)) == NULL) ||
+		   ((buffers[i].errno_counts = calloc(MAX_ERRNO, sizeof(long))) == NULL) ||
+		   ((buffers[i].root_counts = calloc(nr_roots, sizeof(long))) == NULL)) {
+			perror("malloc 'buffers': ");
+			exit(EXIT_FAILURE);
+		}
+	}
+	mem_add(MEM_BUFFERS, thread_max * (REPORT_BUF_SIZE + (MAX_ERRNO + nr_roots) * sizeof(long)));
+}
+
+/*
+*	Reports an error and sets the exit status. The message is formatted like
+*	perror, followed by ': ' and the description of err.
+*
+*	@thread_id: The id of the calling thread.
+*	@root: The id of the file given by the user that the error was found in.
+*	@err: The errno of the error.
+*	@fmt: printf format of the message.
+*
+*	Returns: Nothing.
+*
+*/
+void report_error(int thread_id, int root, int err, const char *fmt, ...) {
+	struct report_buffer *b = &buffers[thread_id];
+	char msg[REPORT_MSG_MAX];
+	va_list args;
+	int len;
+
+	atomic_store_explicit(&exit_status, 1, memory_order_relaxed);
+	PROBE3(error, thread_id, err, root);
+
+	b->errno_counts[err >= 0 && err < MAX_ERRNO ? err : 0]++;
+	b->root_counts[root]++;
+	if(error_summary) {
+		return;
+	}
+
+	va_start(args, fmt);
+	len = vsnprintf(msg, sizeof(msg), fmt, args);
+	va_end(args);
+	if(len < 0) {
+		return;
+	}
+	if((size_t)len >= sizeof(msg)) {
+		len = sizeof(msg) - 1;
+	}
+	len += snprintf(msg + len, sizeof(msg) - len, ": %s\n", strerror(err));
+	if((size_t)len >= sizeof(msg)) {
+		len = sizeof(msg) - 1;
+		msg[len - 1] = '\n';
+	}
+
+	if(b->len + len > REPORT_BUF_SIZE) {
+		report_flush(thread_id);
+	}
+	memcpy(b->buf + b->len, msg, len);
+	b->len += len;
+}
+
+/*
+*	Writes the buffered messages of a thread to stderr.
+*
+*	@thread_id: The id of the thread.
+*
+*	Returns: Nothing.
+*
+*/
+void report_flush(int thread_id) {
+	struct report_buffer *b = &buffers[thread_id];
+
+	write_all(b->buf, b->len);
+	b->len = 0;
+}
+
+/*
+*	Writes a buffer to stderr, retrying on partial writes.
+*
+*	@buf: The buffer.
+*	@len: Number of bytes to write.
+*
+*	Returns: Nothing.
+*
+*/
+static void write_all(const char *buf, size_t len) {
+	while(len > 0) {
+		ssize_t n = write(STDERR_FILENO, buf, len);
+		if(n < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+/*
+*	Prints the number of errors per errno and per given file to stderr.
+*
+*	@files: The arguments given to the program.
+*
+*	Returns: Nothing.
+*
+*/
+void print_error_summary(char **files) {
+	long total = 0;
+
+	for(int e = 0; e < MAX_ERRNO; e++) {
+		long count = report_errors(e);
+		if(count > 0) {
+			const char *name = strerrorname_np(e);
+			fprintf(stderr, "%ld\t%s\t%s\n", count, name != NULL ? name : "?", strerror(e));
+			total += count;
+		}
+	}
+
+	for(int r = 0; r < nr_report_roots; r++) {
+		long count = 0;
+		for(int i = 0; i < nr_buffers; i++) {
+			count += buffers[i].root_counts[r];
+		}
+		if(count > 0) {
+			fprintf(stderr, "%ld\t%s\n", count, files[optind + r]);
+		}
+	}
+	fprintf(stderr, "%ld\terrors\n", total);
+}
+
+/*
+*	Counts the errors with an errno over all threads.
+*
+*	@err: The errno, below MAX_ERRNO.
+*
+*	Returns: The number of errors.
+*
+*/
+long report_errors(int err) {
+	long count = 0;
+	for(int i = 0; i < nr_buffers; i++) {
+		count += buffers[i].errno_counts[err];
+	}
+	return count;
+}
+
+/*
+*	Frees the buffers, anything still in them is lost.
+*
+*	Returns: Nothing.
+*
+*/
+void report_free(void) {
+	for(int i = 0; i < nr_buffers; i++) {
+		free(buffers[i].buf);
+		free(buffers[i].errno_counts);
+		free(buffers[i].root_counts);
+	}
+	free(buffers);
+}
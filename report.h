@@ -0,0 +1,33 @@
+/*
+*	Error reporting for mdu.
+*
+*	Every thread writes its error messages to its own buffer which is written
+*	to stderr in one call when it is full or when the thread is done, so
+*	threads never wait for each other to report an error. In summary mode the
+*	messages are not written at all, only counted per errno and per root.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+//Errors with a larger errno are counted as errno 0.
+#define MAX_ERRNO 256
+
+extern atomic_int exit_status;
+extern bool error_summary;
+
+void report_init(int thread_max, int nr_roots);
+void report_error(int thread_id, int root, int err, const char *fmt, ...)
+	__attribute__((format(printf, 4, 5)));
+void report_flush(int thread_id);
+void print_error_summary(char **files);
+long report_errors(int err);
+void report_free(void);
+
+#endif
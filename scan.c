@@ -0,0 +1,265 @@
+/*
+*	Directory scanning kernels for mdu.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "scan.h"
+#include "report.h"
+#include "fs.h"
+#include "record.h"
+#include "stats.h"
+#include "lathist.h"
+#include "progress.h"
+#include "probes.h"
+#include "mem.h"
+#include "top.h"
+#include "sizehist.h"
+#include "owner.h"
+
+//-------global variables--------
+const struct scheduler *sched = &stack_scheduler;
+unsigned int kernel_flags = 0;
+kernel_fn get_directory_size;
+long long *root_entries;
+long long *root_bytes;
+int count_stride;
+
+static char **excludes;
+static int nr_excludes;
+static int nr_count_threads;
+static int nr_count_roots;
+
+//Specialized kernels, the flags are constants so every feature that is off
+//is compiled out.
+#define KERNEL_VARIANT default
+#define KERNEL_FLAGS 0
+#include "kernel.h"
+
+#define KERNEL_VARIANT exclude
+#define KERNEL_FLAGS KF_EXCLUDE
+#include "kernel.h"
+
+#define KERNEL_VARIANT vfs
+#define KERNEL_FLAGS KF_VFS
+#include "kernel.h"
+
+#define KERNEL_VARIANT stats
+#define KERNEL_FLAGS (KF_STATS | KF_MEM)
+#include "kernel.h"
+
+#define KERNEL_VARIANT progress
+#define KERNEL_FLAGS KF_PROGRESS
+#include "kernel.h"
+
+#define KERNEL_VARIANT count
+#define KERNEL_FLAGS KF_COUNT
+#include "kernel.h"
+
+#define KERNEL_VARIANT apparent
+#define KERNEL_FLAGS KF_APPARENT
+#include "kernel.h"
+
+#define KERNEL_VARIANT inodes
+#define KERNEL_FLAGS (KF_INODES | KF_COUNT)
+#include "kernel.h"
+
+//Fallback for combinations without a kernel of their own, it checks the flags
+//at runtime.
+#define KERNEL_VARIANT generic
+#define KERNEL_FLAGS kernel_flags
+#include "kernel.h"
+
+const struct kernel_variant kernel_variants[] = {
+	{"default", 0, get_directory_size_default},
+	{"exclude", KF_EXCLUDE, get_directory_size_exclude},
+	{"vfs", KF_VFS, get_directory_size_vfs},
+	{"stats", KF_STATS | KF_MEM, get_directory_size_stats},
+	{"progress", KF_PROGRESS, get_directory_size_progress},
+	{"count", KF_COUNT, get_directory_size_count},
+	{"apparent", KF_APPARENT, get_directory_size_apparent},
+	{"inodes", KF_INODES | KF_COUNT, get_directory_size_inodes},
+	{"generic", 0, get_directory_size_generic},
+	{NULL, 0, NULL}
+};
+
+/*
+*	Finds the kernel specialized for the given flags.
+*
+*	@flags: The KF_* flags of the options given by the user.
+*
+*	Returns: The specialized kernel or the generic kernel if there is none.
+*
+*/
+const struct kernel_variant *select_kernel(unsigned int flags) {
+	const struct kernel_variant *v;
+
+	for(v = kernel_variants; strcmp(v->name, "generic") != 0; v++) {
+		if(v->flags == flags) {
+			return v;
+		}
+	}
+	return v;
+}
+
+/*
+*	Allocates the entry and apparent size counters of every thread and root.
+*
+*	@thread_max: Number of threads, the main thread counts into thread 0.
+*	@nr_roots: Number of files given by the user.
+*
+*	Returns: Nothing.
+*
+*/
+void count_init(int thread_max, int nr_roots) {
+	//Rows are padded to whole cache lines so threads never share one.
+	count_stride = (nr_roots + 7) / 8 * 8;
+	nr_count_threads = thread_max;
+	nr_count_roots = nr_roots;
+	if((root_entries = aligned_alloc(64, thread_max * count_stride * sizeof(long long))) == NULL ||
+			(root_bytes = aligned_alloc(64, thread_max * count_stride * sizeof(long long))) == NULL) {
+		perror("aligned_alloc 'root_entries': ");
+		exit(EXIT_FAILURE);
+	}
+	memset(root_entries, 0, thread_max * count_stride * sizeof(long long));
+	memset(root_bytes, 0, thread_max * count_stride * sizeof(long long));
+}
+
+/*
+*	Sums the entries of a root over all threads.
+*
+*	@root: The id of the file given by the user.
+*
+*	Returns: The number of entries, the root itself included.
+*
+*/
+long long count_entries(int root) {
+	long long count = 0;
+	for(int i = 0; i < nr_count_threads && root < nr_count_roots; i++) {
+		count += root_entries[i * count_stride + root];
+	}
+	return count;
+}
+
+/*
+*	Sums the apparent size of a root over all threads.
+*
+*	@root: The id of the file given by the user.
+*
+*	Returns: The apparent size in bytes, the root itself included.
+*
+*/
+long long count_apparent(int root) {
+	long long bytes = 0;
+	for(int i = 0; i < nr_count_threads && root < nr_count_roots; i++) {
+		bytes += root_bytes[i * count_stride + root];
+	}
+	return bytes;
+}
+
+/*
+*	Frees the entry and apparent size counters.
+*
+*	Returns: Nothing.
+*
+*/
+void count_free(void) {
+	free(root_entries);
+	free(root_bytes);
+}
+
+/*
+*	Adds a directory found in lean mode to the stack of the kernel, growing it
+*	when it is full. The stack is counted as queue memory.
+*
+*	@lean: The stack.
+*	@dir: The directory.
+*
+*	Returns: Nothing.
+*
+*/
+void lean_push(struct lean_stack *lean, struct dir_info dir) {
+	if(lean->len == lean->cap) {
+		int cap = lean->cap == 0 ? 16 : lean->cap * 2;
+		if((lean->dirs = realloc(lean->dirs, cap * sizeof(struct dir_info))) == NULL) {
+			perror("realloc 'lean': ");
+			exit(EXIT_FAILURE);
+		}
+		mem_add(MEM_QUEUE, (long long)(cap - lean->cap) * sizeof(struct dir_info));
+		lean->cap = cap;
+	}
+	lean->dirs[lean->len++] = dir;
+}
+
+/*
+*	Frees the stack of a kernel.
+*
+*	@lean: The stack, which must be empty.
+*
+*	Returns: Nothing.
+*
+*/
+void lean_free(struct lean_stack *lean) {
+	mem_add(MEM_QUEUE, -(long long)(lean->cap * sizeof(struct dir_info)));
+	free(lean->dirs);
+}
+
+/*
+*	Adds a pattern for names that should not be measured.
+*
+*	@pattern: A shell wildcard pattern matched against the name of each entry.
+*
+*	Returns: Nothing.
+*
+*/
+void add_exclude(const char *pattern) {
+	if((excludes = realloc(excludes, (nr_excludes + 1) * sizeof(char *))) == NULL) {
+		perror("realloc 'excludes': ");
+		exit(EXIT_FAILURE);
+	}
+	if((excludes[nr_excludes] = strdup(pattern)) == NULL) {
+		perror("strdup: ");
+		exit(EXIT_FAILURE);
+	}
+	nr_excludes++;
+}
+
+/*
+*	Checks if a name matches one of the exclude patterns.
+*
+*	@name: The name of a directory entry.
+*
+*	Returns: True if the entry should be skipped.
+*
+*/
+bool is_excluded(const char *name) {
+	for(int i = 0; i < nr_excludes; i++) {
+		if(fnmatch(excludes[i], name, 0) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+*	Frees the exclude patterns.
+*
+*	Returns: Nothing.
+*
+*/
+void free_excludes(void) {
+	for(int i = 0; i < nr_excludes; i++) {
+		free(excludes[i]);
+	}
+	free(excludes);
+}
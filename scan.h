@@ -0,0 +1,111 @@
+/*
+*	Directory scanning for mdu.
+*
+*	The loop over the entries of a directory is generated from kernel.h as one
+*	kernel per common combination of options. main() picks the kernel once with
+*	select_kernel() so the per-entry loop never checks options that are off.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdbool.h>
+#include <time.h>
+#include "sched.h"
+
+//Options that change what the kernel does for every entry.
+enum kernel_flag {
+	KF_EXCLUDE = 1 << 0,
+	KF_VFS = 1 << 1,
+	KF_RECORD = 1 << 2,
+	KF_STATS = 1 << 3,
+	KF_LATHIST = 1 << 4,
+	KF_PROGRESS = 1 << 5,
+	KF_COUNT = 1 << 6,
+	KF_MEM = 1 << 7,
+	KF_TOP = 1 << 8,
+	KF_HIST = 1 << 9,
+	KF_APPARENT = 1 << 10,
+	KF_INODES = 1 << 11,
+	KF_OWNER = 1 << 12
+};
+
+//Directories a kernel found in lean mode and measures itself, see mem.h.
+struct lean_stack {
+	struct dir_info *dirs;
+	int len;
+	int cap;
+};
+
+typedef long long (*kernel_fn)(struct dir_info file, int thread_id);
+
+struct kernel_variant {
+	const char *name;
+	unsigned int flags;
+	kernel_fn kernel;
+};
+
+extern const struct scheduler *sched;
+extern unsigned int kernel_flags;
+extern kernel_fn get_directory_size;
+extern const struct kernel_variant kernel_variants[];
+extern long long *root_entries;
+extern long long *root_bytes;
+extern int count_stride;
+
+/*
+*	Reads the monotonic clock.
+*
+*	Returns: The time in nanoseconds.
+*
+*/
+static inline long long clock_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+*	Counts an entry of a root, for kernels with KF_COUNT. Every thread has its
+*	own row of counters.
+*
+*	@thread_id: The id of the calling thread.
+*	@root: The id of the file given by the user.
+*
+*	Returns: Nothing.
+*
+*/
+static inline void count_entry(int thread_id, int root) {
+	root_entries[thread_id * count_stride + root]++;
+}
+
+/*
+*	Adds the apparent size of an entry to its root, for kernels with
+*	KF_APPARENT. The rows are laid out like those of count_entry.
+*
+*	@thread_id: The id of the calling thread.
+*	@root: The id of the file given by the user.
+*	@bytes: The st_size of the entry.
+*
+*	Returns: Nothing.
+*
+*/
+static inline void count_bytes(int thread_id, int root, long long bytes) {
+	root_bytes[thread_id * count_stride + root] += bytes;
+}
+
+const struct kernel_variant *select_kernel(unsigned int flags);
+void count_init(int thread_max, int nr_roots);
+long long count_entries(int root);
+long long count_apparent(int root);
+void count_free(void);
+void lean_push(struct lean_stack *lean, struct dir_info dir);
+void lean_free(struct lean_stack *lean);
+void add_exclude(const char *pattern);
+bool is_excluded(const char *name);
+void free_excludes(void);
+
+#endif
@@ -0,0 +1,914 @@
+/*
+*	Scheduler backends for mdu.
+*
+*	stack: The original mutex protected stack with a counting semaphore.
+*	ring: A bounded lock-free multi-producer multi-consumer ring with a mutex
+*				protected spill stack for when the ring is full.
+*	steal: One deque per worker. Workers use their own deque as a stack and steal
+*				 the oldest directory of another worker when their own is empty.
+*	dfs: A plain stack walked depth first by a single worker.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "sched.h"
+#include "stats.h"
+#include "trace.h"
+#include "lockprof.h"
+#include "probes.h"
+#include "mem.h"
+
+#define RING_SIZE (1 << 16)
+#define DEQUE_START_SIZE 64
+
+static void *sched_alloc(size_t size, const char *what);
+static void sched_park(int thread_id);
+static void idle_init(int thread_max, bool (*has_work)(void));
+static bool idle_finish(int thread_id);
+static bool idle_park(int thread_id);
+static void idle_wake(void);
+static void idle_destroy(void);
+
+static void stack_init(int thread_max);
+static void stack_push(int thread_id, struct dir_info f);
+static bool stack_pop(int thread_id, struct dir_info *f);
+static void stack_destroy(void);
+
+static bool ring_enqueue(struct dir_info f);
+static bool ring_dequeue(struct dir_info *f);
+static bool ring_has_work(void);
+static void ring_init(int thread_max);
+static void ring_push(int thread_id, struct dir_info f);
+static bool ring_pop(int thread_id, struct dir_info *f);
+static void ring_destroy(void);
+
+static bool steal_has_work(void);
+static bool steal_take(int thread_id, int victim, bool own, struct dir_info *f);
+static void steal_init(int thread_max);
+static void steal_push(int thread_id, struct dir_info f);
+static bool steal_pop(int thread_id, struct dir_info *f);
+static void steal_destroy(void);
+
+static void dfs_init(int thread_max);
+static void dfs_push(int thread_id, struct dir_info f);
+static bool dfs_pop(int thread_id, struct dir_info *f);
+static void dfs_destroy(void);
+
+const struct scheduler stack_scheduler = {
+	"stack", stack_init, stack_push, stack_pop, stack_destroy
+};
+const struct scheduler ring_scheduler = {
+	"ring", ring_init, ring_push, ring_pop, ring_destroy
+};
+const struct scheduler steal_scheduler = {
+	"steal", steal_init, steal_push, steal_pop, steal_destroy
+};
+const struct scheduler dfs_scheduler = {
+	"dfs", dfs_init, dfs_push, dfs_pop, dfs_destroy
+};
+
+static const struct scheduler *schedulers[] = {
+	&stack_scheduler, &ring_scheduler, &steal_scheduler, &dfs_scheduler, NULL
+};
+
+/*
+*	Finds a scheduler by name.
+*
+*	@name: The name given to --scheduler.
+*
+*	Returns: The scheduler or NULL if there is no scheduler with that name.
+*
+*/
+const struct scheduler *find_scheduler(const char *name) {
+	for(int i = 0; schedulers[i] != NULL; i++) {
+		if(strcmp(schedulers[i]->name, name) == 0) {
+			return schedulers[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+*	Prints the names of all schedulers separated by '|'.
+*
+*	@stream: The stream to print to.
+*
+*	Returns: Nothing.
+*
+*/
+void list_schedulers(FILE *stream) {
+	for(int i = 0; schedulers[i] != NULL; i++) {
+		fprintf(stream, "%s%s", i > 0 ? "|" : "", schedulers[i]->name);
+	}
+}
+
+/*
+*	malloc that exits the program if the allocation fails.
+*
+*	@size: Number of bytes to allocate.
+*	@what: Name of the allocation used in the error message.
+*
+*	Returns: The allocated memory.
+*
+*/
+static void *sched_alloc(size_t size, const char *what) {
+	void *p;
+	if((p = malloc(size)) == NULL) {
+		fprintf(stderr, "malloc '%s': ", what);
+		perror("");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+/*
+*	Locks a mutex, counting the time spent waiting for it in the statistics
+*	of the thread. A macro so lock profiling sees the line of the caller.
+*
+*	@thread_id: The id of the calling thread.
+*	@lock: The mutex.
+*
+*/
+#define sched_lock(thread_id, lock) do { \
+		long long lock_start = stats_clock(); \
+		mutex_lock(thread_id, lock); \
+		if(stats_enabled) { \
+			thread_stats[thread_id].lock_wait_ns += stats_clock() - lock_start; \
+		} \
+	} while(0)
+
+//-------------------------------idle handling---------------------------------
+//Shared by the ring and steal schedulers. 'pending' counts directories that
+//have been pushed but not finished, when it reaches zero all work is done.
+//Workers that find no work park on 'idle_sem'; pushers only post the
+//semaphore when someone is parked so the fast path stays free of syscalls.
+
+static atomic_long pending;
+static atomic_int sleepers;
+static atomic_bool finished;
+static sem_t idle_sem;
+static bool *busy;
+static int idle_threads;
+static bool (*idle_has_work)(void);
+
+/*
+*	Initializes the idle handling.
+*
+*	@thread_max: Number of workers.
+*	@has_work: Function that returns true if the queue might have work in it.
+*
+*	Returns: Nothing.
+*
+*/
+static void idle_init(int thread_max, bool (*has_work)(void)) {
+	atomic_store(&pending, 0);
+	atomic_store(&sleepers, 0);
+	atomic_store(&finished, false);
+	if(sem_init(&idle_sem, 0, 0) < 0) {
+		perror("sem_init: ");
+		exit(EXIT_FAILURE);
+	}
+	busy = sched_alloc(thread_max * sizeof(bool), "busy");
+	for(int i = 0; i < thread_max; i++) {
+		busy[i] = false;
+	}
+	idle_threads = thread_max;
+	idle_has_work = has_work;
+}
+
+/*
+*	Marks the previous directory of a worker as finished. If it was the last
+*	unfinished directory all parked workers are woken up.
+*
+*	@thread_id: The worker calling pop.
+*
+*	Returns: True if all work is done.
+*
+*/
+static bool idle_finish(int thread_id) {
+	if(busy[thread_id]) {
+		busy[thread_id] = false;
+		if(atomic_fetch_sub(&pending, 1) == 1) {
+			atomic_store(&finished, true);
+			for(int i = 0; i < idle_threads; i++) {
+				sem_post(&idle_sem);
+			}
+		}
+	}
+	return atomic_load(&finished);
+}
+
+/*
+*	Parks the calling worker until there might be work or everything is done.
+*	The worker registers as a sleeper before checking the queue a last time so
+*	a concurrent push either sees the sleeper or gets seen by the check.
+*
+*	@thread_id: The id of the worker.
+*
+*	Returns: True if the worker blocked.
+*
+*/
+static bool idle_park(int thread_id) {
+	bool blocked = false;
+
+	atomic_fetch_add(&sleepers, 1);
+	atomic_thread_fence(memory_order_seq_cst);
+	if(!atomic_load(&finished) && !idle_has_work()) {
+		blocked = semaphore_wait(thread_id, &idle_sem);
+	}
+	atomic_fetch_sub(&sleepers, 1);
+	return blocked;
+}
+
+/*
+*	Parks a worker, counting the time as idle in its statistics, and in the
+*	trace if it blocked.
+*
+*	@thread_id: The id of the worker.
+*
+*	Returns: Nothing.
+*
+*/
+static void sched_park(int thread_id) {
+	long long start = stats_clock();
+	long long trace_start = trace_clock();
+	bool blocked;
+
+	PROBE1(worker__park, thread_id);
+	blocked = idle_park(thread_id);
+	PROBE1(worker__wake, thread_id);
+	if(stats_enabled) {
+		thread_stats[thread_id].idle_ns += stats_clock() - start;
+	}
+	if(trace_enabled && blocked) {
+		trace_wait(thread_id, trace_start);
+	}
+}
+
+/*
+*	Wakes a parked worker after a push, if there is one.
+*
+*	Returns: Nothing.
+*
+*/
+static void idle_wake(void) {
+	atomic_thread_fence(memory_order_seq_cst);
+	if(atomic_load(&sleepers) > 0) {
+		sem_post(&idle_sem);
+	}
+}
+
+/*
+*	Frees the idle handling.
+*
+*	Returns: Nothing.
+*
+*/
+static void idle_destroy(void) {
+	sem_destroy(&idle_sem);
+	free(busy);
+}
+
+//-----------------------------------stack-------------------------------------
+
+static pthread_mutex_t available_lock;
+static sem_t available_sem;
+static int nr_available_files;
+static bool *done_threads;
+static bool done;
+static struct dir_info *available_files;
+static int stack_threads;
+static long long available_bytes;
+
+/*
+*	initialize the mutex, semaphore and the array of files.
+*
+*	@thread_max: The number of threads to run in the program.
+*
+*	Returns: Nothing if succesfull.
+*
+*/
+static void stack_init(int thread_max) {
+	if(pthread_mutex_init(&available_lock, NULL) != 0) {
+		perror("pthread_mutex_init: ");
+	}
+
+	if(sem_init(&available_sem, 0, 0) < 0) {
+		perror("sem_init: ");
+		exit(EXIT_FAILURE);
+	}
+
+	available_files = sched_alloc(1, "available_files");
+	done_threads = sched_alloc(thread_max * sizeof(bool), "done_threads");
+
+	for(int i = 0; i < thread_max; i++) {
+		done_threads[i] = false;
+	}
+	nr_available_files = 0;
+	available_bytes = 0;
+	done = false;
+	stack_threads = thread_max;
+}
+
+/*
+*	Adds a file struct to the global array of file structs and signals that
+*	there is a file available.
+*
+*	@thread_id: The id of the calling thread.
+*	@f: The file struct to be put into the array.
+*
+*	Returns: Nothing if succesfull.
+*
+*/
+static void stack_push(int thread_id, struct dir_info f) {
+	PROBE2(work__push, thread_id, f.name);
+	sched_lock(thread_id, &available_lock);
+	nr_available_files++;
+	if((available_files = realloc(available_files, nr_available_files * sizeof(struct dir_info))) == NULL) {
+		perror("realloc 'available_files': ");
+		exit(EXIT_FAILURE);
+	}
+	available_files[nr_available_files - 1] = f;
+	mem_add(MEM_QUEUE, (long long)(nr_available_files * sizeof(struct dir_info)) - available_bytes);
+	available_bytes = nr_available_files * sizeof(struct dir_info);
+	stats_queue_depth(thread_id, nr_available_files);
+	mutex_unlock(thread_id, &available_lock);
+	sem_post(&available_sem);
+}
+
+/*
+*	Gets a file struct from the global array of file structs. Waits on the
+*	semaphore until a file is available or all threads are done.
+*
+*	@thread_id: The id of the calling thread.
+*	@f: Where the file struct is stored.
+*
+*	Returns: False once all threads have finished their work.
+*
+*/
+static bool stack_pop(int thread_id, struct dir_info *f) {
+	//Lock the use if 'nr_available_files' and 'done' global variables then
+	//check if threads are done.
+	sched_lock(thread_id, &available_lock);
+	done_threads[thread_id] = true;
+	if(nr_available_files == 0) {
+		done = true;
+		for(int i = 0; i < stack_threads; i++) {
+			if(done_threads[i] == false) {
+				done = false;
+				break;
+			}
+		}
+		//If all threads are done, signal all other threads incase one is waiting
+		//on the semaphore.
+		if(done) {
+			for(int i = 0; i < stack_threads; i++) {
+				sem_post(&available_sem);
+			}
+			mutex_unlock(thread_id, &available_lock);
+			return false;
+		}
+	}
+	mutex_unlock(thread_id, &available_lock);
+
+	long long start = stats_clock();
+	long long trace_start = trace_clock();
+	PROBE1(worker__park, thread_id);
+	bool blocked = semaphore_wait(thread_id, &available_sem);
+	PROBE1(worker__wake, thread_id);
+	if(stats_enabled) {
+		thread_stats[thread_id].idle_ns += stats_clock() - start;
+	}
+	//A directory that was already queued is no wait worth a trace event.
+	if(trace_enabled && blocked) {
+		trace_wait(thread_id, trace_start);
+	}
+	//If all threads are done exit.
+	if(done) {
+		return false;
+	}
+
+	done_threads[thread_id] = false;
+
+	sched_lock(thread_id, &available_lock);
+	nr_available_files--;
+	*f = available_files[nr_available_files];
+	mutex_unlock(thread_id, &available_lock);
+
+	PROBE2(work__pop, thread_id, f->name);
+	return true;
+}
+
+/*
+*	Destroys the mutex and semaphore and frees the array of files.
+*
+*	Returns: Nothing.
+*
+*/
+static void stack_destroy(void) {
+	pthread_mutex_destroy(&available_lock);
+	if(sem_destroy(&available_sem) < 0) {
+		perror("sem_destroy: ");
+		exit(EXIT_FAILURE);
+	}
+	free(done_threads);
+	free(available_files);
+}
+
+//-----------------------------------ring--------------------------------------
+//Bounded queue by Dmitry Vyukov. Every cell has a sequence number telling
+//whether it is ready to be written (seq == pos) or read (seq == pos + 1) for a
+//given position. Directories that do not fit in the ring go on the spill stack.
+
+struct ring_cell {
+	atomic_size_t seq;
+	struct dir_info data;
+};
+
+static struct ring_cell *ring_cells;
+static atomic_size_t ring_head;
+static atomic_size_t ring_tail;
+static pthread_mutex_t spill_lock;
+static struct dir_info *spill;
+static int nr_spill;
+static int spill_max;
+static atomic_int spill_count;
+
+/*
+*	Puts a directory in the ring.
+*
+*	@f: The directory.
+*
+*	Returns: False if the ring is full.
+*
+*/
+static bool ring_enqueue(struct dir_info f) {
+	struct ring_cell *cell;
+	size_t pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+
+	while(1) {
+		cell = &ring_cells[pos & (RING_SIZE - 1)];
+		size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+		intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+		if(dif == 0) {
+			if(atomic_compare_exchange_weak_explicit(&ring_tail, &pos, pos + 1,
+					memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		}
+		else if(dif < 0) {
+			return false;
+		}
+		else {
+			pos = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+		}
+	}
+
+	cell->data = f;
+	atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+	return true;
+}
+
+/*
+*	Takes a directory from the ring.
+*
+*	@f: Where the directory is stored.
+*
+*	Returns: False if the ring is empty.
+*
+*/
+static bool ring_dequeue(struct dir_info *f) {
+	struct ring_cell *cell;
+	size_t pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+
+	while(1) {
+		cell = &ring_cells[pos & (RING_SIZE - 1)];
+		size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+		intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+		if(dif == 0) {
+			if(atomic_compare_exchange_weak_explicit(&ring_head, &pos, pos + 1,
+					memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		}
+		else if(dif < 0) {
+			return false;
+		}
+		else {
+			pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+		}
+	}
+
+	*f = cell->data;
+	atomic_store_explicit(&cell->seq, pos + RING_SIZE, memory_order_release);
+	return true;
+}
+
+/*
+*	Checks if the ring or the spill stack might contain a directory.
+*
+*	Returns: True if there might be work.
+*
+*/
+static bool ring_has_work(void) {
+	return atomic_load(&ring_tail) != atomic_load(&ring_head) ||
+		atomic_load(&spill_count) > 0;
+}
+
+/*
+*	Allocates the ring and the spill stack.
+*
+*	@thread_max: The number of workers.
+*
+*	Returns: Nothing.
+*
+*/
+static void ring_init(int thread_max) {
+	ring_cells = sched_alloc(RING_SIZE * sizeof(struct ring_cell), "ring_cells");
+	mem_add(MEM_QUEUE, RING_SIZE * sizeof(struct ring_cell));
+	for(size_t i = 0; i < RING_SIZE; i++) {
+		atomic_init(&ring_cells[i].seq, i);
+	}
+	atomic_store(&ring_head, 0);
+	atomic_store(&ring_tail, 0);
+
+	if(pthread_mutex_init(&spill_lock, NULL) != 0) {
+		perror("pthread_mutex_init: ");
+	}
+	spill = NULL;
+	nr_spill = 0;
+	spill_max = 0;
+	atomic_store(&spill_count, 0);
+
+	idle_init(thread_max, ring_has_work);
+}
+
+/*
+*	Adds a directory to the ring, or to the spill stack if the ring is full.
+*
+*	@thread_id: The id of the calling worker.
+*	@f: The directory.
+*
+*	Returns: Nothing.
+*
+*/
+static void ring_push(int thread_id, struct dir_info f) {
+	PROBE2(work__push, thread_id, f.name);
+	atomic_fetch_add(&pending, 1);
+
+	if(!ring_enqueue(f)) {
+		sched_lock(thread_id, &spill_lock);
+		if(nr_spill == spill_max) {
+			mem_add(MEM_QUEUE, (spill_max == 0 ? DEQUE_START_SIZE : spill_max) * sizeof(struct dir_info));
+			spill_max = spill_max == 0 ? DEQUE_START_SIZE : spill_max * 2;
+			if((spill = realloc(spill, spill_max * sizeof(struct dir_info))) == NULL) {
+				perror("realloc 'spill': ");
+				exit(EXIT_FAILURE);
+			}
+		}
+		spill[nr_spill++] = f;
+		atomic_fetch_add(&spill_count, 1);
+		mutex_unlock(thread_id, &spill_lock);
+	}
+	if(stats_enabled) {
+		stats_queue_depth(thread_id, atomic_load_explicit(&ring_tail, memory_order_relaxed) -
+			atomic_load_explicit(&ring_head, memory_order_relaxed) + atomic_load(&spill_count));
+	}
+	idle_wake();
+}
+
+/*
+*	Takes a directory from the ring or the spill stack, parking the worker while
+*	both are empty.
+*
+*	@thread_id: The id of the calling worker.
+*	@f: Where the directory is stored.
+*
+*	Returns: False once all directories are finished.
+*
+*/
+static bool ring_pop(int thread_id, struct dir_info *f) {
+	if(idle_finish(thread_id)) {
+		return false;
+	}
+
+	while(1) {
+		if(ring_dequeue(f)) {
+			break;
+		}
+		if(atomic_load(&spill_count) > 0) {
+			bool found = false;
+			sched_lock(thread_id, &spill_lock);
+			if(nr_spill > 0) {
+				*f = spill[--nr_spill];
+				atomic_fetch_sub(&spill_count, 1);
+				found = true;
+			}
+			mutex_unlock(thread_id, &spill_lock);
+			if(found) {
+				break;
+			}
+		}
+		if(atomic_load(&finished)) {
+			return false;
+		}
+		sched_park(thread_id);
+	}
+
+	busy[thread_id] = true;
+	PROBE2(work__pop, thread_id, f->name);
+	return true;
+}
+
+/*
+*	Frees the ring and the spill stack.
+*
+*	Returns: Nothing.
+*
+*/
+static void ring_destroy(void) {
+	idle_destroy();
+	pthread_mutex_destroy(&spill_lock);
+	free(spill);
+	free(ring_cells);
+}
+
+//-----------------------------------steal-------------------------------------
+//Every worker owns a deque. The owner pushes and pops at the tail so it walks
+//its part of the tree depth first, thieves take from the head where the
+//directories closest to the root, and thereby the largest subtrees, are.
+
+struct deque {
+	pthread_mutex_t lock;
+	struct dir_info *items;
+	size_t head;
+	size_t tail;
+	size_t cap;
+	atomic_size_t size;
+};
+
+static struct deque *deques;
+static int nr_deques;
+static unsigned int *steal_seeds;
+
+/*
+*	Checks if any deque might contain a directory.
+*
+*	Returns: True if there might be work.
+*
+*/
+static bool steal_has_work(void) {
+	for(int i = 0; i < nr_deques; i++) {
+		if(atomic_load(&deques[i].size) > 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+*	Takes a directory from a deque.
+*
+*	@thread_id: The id of the calling worker.
+*	@victim: The deque to take from.
+*	@own: True if the caller owns the deque, it then takes the newest directory
+*				instead of the oldest.
+*	@f: Where the directory is stored.
+*
+*	Returns: False if the deque was empty.
+*
+*/
+static bool steal_take(int thread_id, int victim, bool own, struct dir_info *f) {
+	struct deque *d = &deques[victim];
+
+	if(atomic_load_explicit(&d->size, memory_order_relaxed) == 0) {
+		return false;
+	}
+
+	sched_lock(thread_id, &d->lock);
+	if(d->head == d->tail) {
+		mutex_unlock(thread_id, &d->lock);
+		return false;
+	}
+	if(own) {
+		d->tail--;
+		*f = d->items[d->tail % d->cap];
+	}
+	else {
+		*f = d->items[d->head % d->cap];
+		d->head++;
+	}
+	atomic_store_explicit(&d->size, d->tail - d->head, memory_order_relaxed);
+	mutex_unlock(thread_id, &d->lock);
+	return true;
+}
+
+/*
+*	Allocates one deque per worker.
+*
+*	@thread_max: The number of workers.
+*
+*	Returns: Nothing.
+*
+*/
+static void steal_init(int thread_max) {
+	nr_deques = thread_max;
+	deques = sched_alloc(thread_max * sizeof(struct deque), "deques");
+	steal_seeds = sched_alloc(thread_max * sizeof(unsigned int), "steal_seeds");
+
+	for(int i = 0; i < thread_max; i++) {
+		if(pthread_mutex_init(&deques[i].lock, NULL) != 0) {
+			perror("pthread_mutex_init: ");
+		}
+		deques[i].items = sched_alloc(DEQUE_START_SIZE * sizeof(struct dir_info), "deque");
+		mem_add(MEM_QUEUE, DEQUE_START_SIZE * sizeof(struct dir_info));
+		deques[i].head = 0;
+		deques[i].tail = 0;
+		deques[i].cap = DEQUE_START_SIZE;
+		atomic_init(&deques[i].size, 0);
+		steal_seeds[i] = i + 1;
+	}
+
+	idle_init(thread_max, steal_has_work);
+}
+
+/*
+*	Pushes a directory on the deque of the worker that found it.
+*
+*	@thread_id: The id of the pushing worker.
+*	@f: The directory.
+*
+*	Returns: Nothing.
+*
+*/
+static void steal_push(int thread_id, struct dir_info f) {
+	PROBE2(work__push, thread_id, f.name);
+	struct deque *d = &deques[thread_id];
+
+	atomic_fetch_add(&pending, 1);
+
+	sched_lock(thread_id, &d->lock);
+	if(d->tail - d->head == d->cap) {
+		struct dir_info *items = sched_alloc(d->cap * 2 * sizeof(struct dir_info), "deque");
+		mem_add(MEM_QUEUE, d->cap * sizeof(struct dir_info));
+		for(size_t i = d->head; i < d->tail; i++) {
+			items[i % (d->cap * 2)] = d->items[i % d->cap];
+		}
+		free(d->items);
+		d->items = items;
+		d->cap *= 2;
+	}
+	d->items[d->tail % d->cap] = f;
+	d->tail++;
+	atomic_store_explicit(&d->size, d->tail - d->head, memory_order_relaxed);
+	stats_queue_depth(thread_id, d->tail - d->head);
+	mutex_unlock(thread_id, &d->lock);
+
+	idle_wake();
+}
+
+/*
+*	Takes a directory from the own deque or steals one from a random victim,
+*	parking the worker while all deques are empty.
+*
+*	@thread_id: The id of the calling worker.
+*	@f: Where the directory is stored.
+*
+*	Returns: False once all directories are finished.
+*
+*/
+static bool steal_pop(int thread_id, struct dir_info *f) {
+	if(idle_finish(thread_id)) {
+		return false;
+	}
+
+	while(!steal_take(thread_id, thread_id, true, f)) {
+		bool found = false;
+		int start = rand_r(&steal_seeds[thread_id]) % nr_deques;
+		int victim = thread_id;
+		for(int i = 0; i < nr_deques && !found; i++) {
+			victim = (start + i) % nr_deques;
+			if(victim != thread_id) {
+				found = steal_take(thread_id, victim, false, f);
+			}
+		}
+		if(found) {
+			if(stats_enabled) {
+				thread_stats[thread_id].steals++;
+			}
+			if(trace_enabled) {
+				trace_steal(thread_id, victim);
+			}
+			PROBE2(work__steal, thread_id, victim);
+			break;
+		}
+		if(atomic_load(&finished)) {
+			return false;
+		}
+		sched_park(thread_id);
+	}
+
+	busy[thread_id] = true;
+	PROBE2(work__pop, thread_id, f->name);
+	return true;
+}
+
+/*
+*	Frees the deques.
+*
+*	Returns: Nothing.
+*
+*/
+static void steal_destroy(void) {
+	idle_destroy();
+	for(int i = 0; i < nr_deques; i++) {
+		pthread_mutex_destroy(&deques[i].lock);
+		free(deques[i].items);
+	}
+	free(deques);
+	free(steal_seeds);
+}
+
+//------------------------------------dfs--------------------------------------
+//Only worker 0 takes directories, every other worker returns at once. The
+//main thread pushes the roots before the workers start, so no locking is
+//needed.
+
+static struct dir_info *dfs_stack;
+static int dfs_size;
+static int dfs_max;
+
+/*
+*	Resets the stack.
+*
+*	@thread_max: Unused.
+*
+*	Returns: Nothing.
+*
+*/
+static void dfs_init(int thread_max) {
+	(void)thread_max;
+	dfs_stack = NULL;
+	dfs_size = 0;
+	dfs_max = 0;
+}
+
+/*
+*	Pushes a directory on the stack.
+*
+*	@thread_id: The id of the calling thread.
+*	@f: The directory.
+*
+*	Returns: Nothing.
+*
+*/
+static void dfs_push(int thread_id, struct dir_info f) {
+	PROBE2(work__push, thread_id, f.name);
+	if(dfs_size == dfs_max) {
+		mem_add(MEM_QUEUE, (dfs_max == 0 ? DEQUE_START_SIZE : dfs_max) * sizeof(struct dir_info));
+		dfs_max = dfs_max == 0 ? DEQUE_START_SIZE : dfs_max * 2;
+		if((dfs_stack = realloc(dfs_stack, dfs_max * sizeof(struct dir_info))) == NULL) {
+			perror("realloc 'dfs_stack': ");
+			exit(EXIT_FAILURE);
+		}
+	}
+	dfs_stack[dfs_size++] = f;
+	stats_queue_depth(thread_id, dfs_size);
+}
+
+/*
+*	Pops the most recently found directory.
+*
+*	@thread_id: The id of the calling worker.
+*	@f: Where the directory is stored.
+*
+*	Returns: False when the stack is empty or the caller is not worker 0.
+*
+*/
+static bool dfs_pop(int thread_id, struct dir_info *f) {
+	if(thread_id != 0 || dfs_size == 0) {
+		return false;
+	}
+	*f = dfs_stack[--dfs_size];
+	PROBE2(work__pop, thread_id, f->name);
+	return true;
+}
+
+/*
+*	Frees the stack.
+*
+*	Returns: Nothing.
+*
+*/
+static void dfs_destroy(void) {
+	free(dfs_stack);
+}
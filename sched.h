@@ -0,0 +1,56 @@
+/*
+*	Scheduler interface for mdu.
+*
+*	A scheduler owns the directories that are waiting to be measured and hands
+*	them out to the worker threads. Every scheduler produces the same totals,
+*	only the order in which directories are visited differs.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+struct top_node;
+
+struct dir_info {
+	int parent_id;
+	unsigned int trace_id;
+	char *name;
+	struct top_node *node;
+};
+
+/*
+*	Operations every scheduler provides.
+*
+*	@name: Name used to select the scheduler with --scheduler.
+*	@init: Allocates the scheduler state for thread_max workers. Called before
+*				 the first push.
+*	@push: Adds a directory to be measured. thread_id is the id of the worker
+*				 that found the directory, the main thread uses 0.
+*	@pop: Waits until a directory is available and stores it in f. Calling pop
+*				again tells the scheduler that the previous directory is finished.
+*				Returns false once every directory has been measured.
+*	@destroy: Frees the scheduler state.
+*/
+struct scheduler {
+	const char *name;
+	void (*init)(int thread_max);
+	void (*push)(int thread_id, struct dir_info f);
+	bool (*pop)(int thread_id, struct dir_info *f);
+	void (*destroy)(void);
+};
+
+extern const struct scheduler stack_scheduler;
+extern const struct scheduler ring_scheduler;
+extern const struct scheduler steal_scheduler;
+extern const struct scheduler dfs_scheduler;
+
+const struct scheduler *find_scheduler(const char *name);
+void list_schedulers(FILE *stream);
+
+#endif
@@ -0,0 +1,303 @@
+/*
+*	Deterministic directory tree shapes.
+*
+*	wide: One directory with many subdirectories.
+*	deep: A chain of directories.
+*	balanced: Every directory has the same number of subdirectories.
+*	zipf: Balanced, but the number of files per directory follows a power law
+*				so most directories are small and a few are very large.
+*	hardlinks, sparse, denied: Balanced with a share of the files hardlinked,
+*				sparse or a share of the directories unreadable.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "shape.h"
+
+//Salts so that the different properties of a node are independent.
+enum {
+	SALT_CHILD = 1,
+	SALT_FILES,
+	SALT_DENIED,
+	SALT_SIZE,
+	SALT_LINK,
+	SALT_SPARSE
+};
+
+static unsigned long long mix(unsigned long long x);
+static unsigned long long hash3(unsigned long long a, unsigned long long b, unsigned long long c);
+static double unit(unsigned long long h);
+static bool set_option(struct shape *s, const char *key, const char *value);
+
+static const struct shape presets[] = {
+	{SHAPE_WIDE, "wide", 1, 1, 5000, 20, 4096, 0, 0, 0, 0, 0},
+	{SHAPE_DEEP, "deep", 1, 500, 1, 4, 4096, 0, 0, 0, 0, 0},
+	{SHAPE_BALANCED, "balanced", 1, 4, 8, 16, 4096, 0, 0, 0, 0, 0},
+	{SHAPE_ZIPF, "zipf", 1, 3, 12, 1000, 4096, 1.5, 0, 0, 0, 0},
+	{SHAPE_BALANCED, "hardlinks", 1, 4, 8, 16, 4096, 0, 0.5, 0, 0, 0},
+	{SHAPE_BALANCED, "sparse", 1, 4, 8, 16, 4096, 0, 0, 0.3, 1 << 20, 0},
+	{SHAPE_BALANCED, "denied", 1, 4, 8, 16, 4096, 0, 0, 0, 0, 0.1}
+};
+
+#define NR_PRESETS (sizeof(presets) / sizeof(presets[0]))
+
+/*
+*	Parses a shape spec.
+*
+*	@spec: A shape name followed by comma separated key=value overrides.
+*	@s: The shape that is filled in.
+*
+*	Returns: False if the spec is not valid.
+*
+*/
+bool parse_shape(const char *spec, struct shape *s) {
+	char *copy, *item, *save;
+	bool ok = true;
+	size_t i;
+
+	if((copy = strdup(spec)) == NULL) {
+		perror("strdup: ");
+		exit(EXIT_FAILURE);
+	}
+
+	item = strtok_r(copy, ",", &save);
+	for(i = 0; item != NULL && i < NR_PRESETS; i++) {
+		if(strcmp(presets[i].name, item) == 0) {
+			break;
+		}
+	}
+	if(item == NULL || i == NR_PRESETS) {
+		free(copy);
+		return false;
+	}
+	*s = presets[i];
+
+	while(ok && (item = strtok_r(NULL, ",", &save)) != NULL) {
+		char *value = strchr(item, '=');
+		if(value == NULL) {
+			ok = false;
+			break;
+		}
+		*value++ = '\0';
+		ok = set_option(s, item, value);
+	}
+
+	free(copy);
+	return ok && s->depth >= 0 && s->fanout >= 0 && s->files >= 0 && s->size >= 0;
+}
+
+/*
+*	Sets one key=value override of a spec.
+*
+*	@s: The shape.
+*	@key: The name of the option.
+*	@value: The value of the option.
+*
+*	Returns: False if the key is unknown or the value is not a number.
+*
+*/
+static bool set_option(struct shape *s, const char *key, const char *value) {
+	char *end;
+	double d = strtod(value, &end);
+
+	if(*value == '\0' || *end != '\0') {
+		return false;
+	}
+
+	if(strcmp(key, "seed") == 0) {
+		s->seed = strtoull(value, NULL, 10);
+	}
+	else if(strcmp(key, "depth") == 0) {
+		s->depth = d;
+	}
+	else if(strcmp(key, "fanout") == 0) {
+		s->fanout = d;
+	}
+	else if(strcmp(key, "files") == 0) {
+		s->files = d;
+	}
+	else if(strcmp(key, "size") == 0) {
+		s->size = d;
+	}
+	else if(strcmp(key, "zipf") == 0) {
+		s->zipf = d;
+	}
+	else if(strcmp(key, "links") == 0) {
+		s->links = d;
+	}
+	else if(strcmp(key, "sparse") == 0) {
+		s->sparse = d;
+	}
+	else if(strcmp(key, "sparse_size") == 0) {
+		s->sparse_size = d;
+	}
+	else if(strcmp(key, "denied") == 0) {
+		s->denied = d;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+/*
+*	Writes the full spec of a shape, with every option, to a buffer.
+*
+*	@s: The shape.
+*	@buf: The buffer.
+*	@len: Size of the buffer.
+*
+*	Returns: Nothing.
+*
+*/
+void format_shape(const struct shape *s, char *buf, size_t len) {
+	snprintf(buf, len, "%s,seed=%llu,depth=%d,fanout=%d,files=%d,size=%lld,"
+		"zipf=%g,links=%g,sparse=%g,sparse_size=%lld,denied=%g",
+		s->name, s->seed, s->depth, s->fanout, s->files, s->size,
+		s->zipf, s->links, s->sparse, s->sparse_size, s->denied);
+}
+
+/*
+*	Prints the names of all shapes separated by '|'.
+*
+*	@stream: The stream to print to.
+*
+*	Returns: Nothing.
+*
+*/
+void list_shapes(FILE *stream) {
+	for(size_t i = 0; i < NR_PRESETS; i++) {
+		fprintf(stream, "%s%s", i > 0 ? "|" : "", presets[i].name);
+	}
+}
+
+/*
+*	Gets the node id of the root directory.
+*
+*	@s: The shape.
+*
+*	Returns: The node id.
+*
+*/
+unsigned long long shape_root(const struct shape *s) {
+	return mix(s->seed);
+}
+
+/*
+*	Gets the node id of a subdirectory.
+*
+*	@s: The shape.
+*	@node: The node id of the parent directory.
+*	@index: The index of the subdirectory in the parent.
+*
+*	Returns: The node id.
+*
+*/
+unsigned long long shape_child(const struct shape *s, unsigned long long node, int index) {
+	(void)s;
+	return hash3(node, SALT_CHILD, index);
+}
+
+/*
+*	Describes the contents of a directory.
+*
+*	@s: The shape.
+*	@node: The node id of the directory.
+*	@depth: The depth of the directory, the root is at depth 0.
+*	@d: Filled in with the number of subdirectories and files.
+*
+*	Returns: Nothing.
+*
+*/
+void describe_dir(const struct shape *s, unsigned long long node, int depth, struct shape_dir *d) {
+	d->nr_dirs = depth < s->depth ? s->fanout : 0;
+	d->nr_files = s->files;
+	d->denied = depth > 0 && unit(hash3(node, SALT_DENIED, 0)) < s->denied;
+
+	//Inverse of the cumulative distribution of p(n) ~ n^-zipf on 1..files.
+	if(s->kind == SHAPE_ZIPF && s->files > 0) {
+		double a = s->zipf != 1 ? 1 - s->zipf : -1e-9;
+		double u = unit(hash3(node, SALT_FILES, 0));
+		double n = pow((pow(s->files, a) - 1) * u + 1, 1 / a);
+		d->nr_files = n < 1 ? 1 : n > s->files ? s->files : (int)n;
+	}
+}
+
+/*
+*	Describes a file.
+*
+*	@s: The shape.
+*	@node: The node id of the directory the file is in.
+*	@index: The index of the file in the directory.
+*	@f: Filled in with the size of the file, if it is sparse and the index of
+*			the file it is a hardlink to, or -1.
+*
+*	Returns: Nothing.
+*
+*/
+void describe_file(const struct shape *s, unsigned long long node, int index, struct shape_file *f) {
+	f->link = -1;
+	f->sparse = false;
+	f->size = s->size > 0 ? hash3(node, SALT_SIZE, index) % (2 * s->size + 1) : 0;
+
+	if(index > 0 && unit(hash3(node, SALT_LINK, index)) < s->links) {
+		f->link = hash3(node, SALT_LINK + 100, index) % index;
+		//A link to a link is a link to the same file.
+		struct shape_file target;
+		describe_file(s, node, f->link, &target);
+		if(target.link >= 0) {
+			f->link = target.link;
+		}
+	}
+	else if(unit(hash3(node, SALT_SPARSE, index)) < s->sparse) {
+		f->sparse = true;
+		f->size = s->sparse_size;
+	}
+}
+
+/*
+*	splitmix64 finalizer.
+*
+*	@x: The value to mix.
+*
+*	Returns: The mixed value.
+*
+*/
+static unsigned long long mix(unsigned long long x) {
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/*
+*	Hashes three values into one.
+*
+*	@a: The first value.
+*	@b: The second value.
+*	@c: The third value.
+*
+*	Returns: The hash.
+*
+*/
+static unsigned long long hash3(unsigned long long a, unsigned long long b, unsigned long long c) {
+	return mix(mix(mix(a) ^ b) ^ c);
+}
+
+/*
+*	Turns a hash into a number in [0, 1).
+*
+*	@h: The hash.
+*
+*	Returns: The number.
+*
+*/
+static double unit(unsigned long long h) {
+	return (h >> 11) * (1.0 / 9007199254740992.0);
+}
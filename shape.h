@@ -0,0 +1,66 @@
+/*
+*	Deterministic directory tree shapes.
+*
+*	A shape describes a tree from a seed: every directory and file is given a
+*	64 bit node id derived from the seed and its position, and everything about
+*	it (number of entries, sizes, hardlinks, permissions) is a hash of that id.
+*	The same spec therefore always describes the same tree, no matter in which
+*	order it is walked.
+*
+*	Specs are comma separated, a shape name followed by key=value overrides:
+*	"balanced,seed=7,depth=5,fanout=10".
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+enum shape_kind {
+	SHAPE_WIDE,
+	SHAPE_DEEP,
+	SHAPE_BALANCED,
+	SHAPE_ZIPF
+};
+
+struct shape {
+	enum shape_kind kind;
+	const char *name;
+	unsigned long long seed;
+	int depth;
+	int fanout;
+	int files;
+	long long size;
+	double zipf;
+	double links;
+	double sparse;
+	long long sparse_size;
+	double denied;
+};
+
+struct shape_dir {
+	int nr_dirs;
+	int nr_files;
+	bool denied;
+};
+
+struct shape_file {
+	long long size;
+	bool sparse;
+	int link;
+};
+
+bool parse_shape(const char *spec, struct shape *s);
+void format_shape(const struct shape *s, char *buf, size_t len);
+void list_shapes(FILE *stream);
+unsigned long long shape_root(const struct shape *s);
+unsigned long long shape_child(const struct shape *s, unsigned long long node, int index);
+void describe_dir(const struct shape *s, unsigned long long node, int depth, struct shape_dir *d);
+void describe_file(const struct shape *s, unsigned long long node, int index, struct shape_file *f);
+
+#endif
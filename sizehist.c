@@ -0,0 +1,110 @@
+/*
+*	File size histograms for --histogram, see sizehist.h.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sizehist.h"
+
+static void format_size(char *buf, size_t len, int shift);
+
+//-------global variables--------
+struct size_bucket *size_buckets;
+int size_stride;
+
+static int nr_hist_threads;
+
+/*
+*	Allocates the buckets of every thread.
+*
+*	@thread_max: Number of threads, the main thread uses the row of thread 0.
+*	@nr_roots: Number of files given by the user.
+*
+*	Returns: Nothing.
+*
+*/
+void sizehist_init(int thread_max, int nr_roots) {
+	size_t bytes = (size_t)thread_max * nr_roots * NR_SIZE_BUCKETS * sizeof(struct size_bucket);
+
+	nr_hist_threads = thread_max;
+	size_stride = nr_roots;
+	//A row of buckets is 1 KiB, so the rows of different threads never share a
+	//cache line.
+	if((size_buckets = aligned_alloc(64, bytes)) == NULL) {
+		perror("aligned_alloc 'size_buckets': ");
+		exit(EXIT_FAILURE);
+	}
+	memset(size_buckets, 0, bytes);
+}
+
+/*
+*	Writes a power of two number of bytes with a binary suffix.
+*
+*	@buf: Where the text is written.
+*	@len: Size of buf.
+*	@shift: The power of two.
+*
+*	Returns: Nothing.
+*
+*/
+static void format_size(char *buf, size_t len, int shift) {
+	const char *suffixes = " KMGTPE";
+
+	if(shift < 10) {
+		snprintf(buf, len, "%d", 1 << shift);
+	}
+	else {
+		snprintf(buf, len, "%d%c", 1 << (shift % 10), suffixes[shift / 10]);
+	}
+}
+
+/*
+*	Merges the threads and prints the non-empty buckets of every root, with
+*	the number of files and their size on the disk in KiB like the totals.
+*
+*	@roots: The files given by the user.
+*
+*	Returns: Nothing.
+*
+*/
+void print_sizehist(char **roots) {
+	char low[16], high[16];
+
+	for(int root = 0; root < size_stride; root++) {
+		printf("size histogram of '%s':\n", roots[root]);
+		for(int b = 0; b < NR_SIZE_BUCKETS; b++) {
+			long long files = 0, blocks = 0;
+			for(int i = 0; i < nr_hist_threads; i++) {
+				struct size_bucket *bucket = &size_buckets[(i * size_stride + root) * NR_SIZE_BUCKETS + b];
+				files += bucket->files;
+				blocks += bucket->blocks;
+			}
+			if(files == 0) {
+				continue;
+			}
+			if(b == 0) {
+				printf("%16s", "0");
+			}
+			else {
+				format_size(low, sizeof(low), b - 1);
+				format_size(high, sizeof(high), b);
+				printf("%7s - <%6s", low, high);
+			}
+			printf("\t%lld files\t%lld\n", files, blocks / 2);
+		}
+	}
+}
+
+/*
+*	Frees the buckets.
+*
+*	Returns: Nothing.
+*
+*/
+void sizehist_free(void) {
+	free(size_buckets);
+}
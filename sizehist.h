@@ -0,0 +1,50 @@
+/*
+*	File size histograms for --histogram.
+*
+*	Every file that is not a directory is counted in the bucket of its size,
+*	one bucket per power of two: bucket 0 holds the empty files and bucket b
+*	the sizes from 2^(b-1) up to 2^b bytes. Every thread has its own row of
+*	buckets per root, so counting is two additions on memory no other thread
+*	writes. The rows are merged when the histograms are printed.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef SIZEHIST_H
+#define SIZEHIST_H
+
+#define NR_SIZE_BUCKETS 64
+
+struct size_bucket {
+	long long files;
+	long long blocks;
+};
+
+extern struct size_bucket *size_buckets;
+extern int size_stride;
+
+void sizehist_init(int thread_max, int nr_roots);
+void print_sizehist(char **roots);
+void sizehist_free(void);
+
+/*
+*	Counts a file of a root in the bucket of its size.
+*
+*	@thread_id: The id of the calling thread.
+*	@root: The id of the file given by the user.
+*	@size: The size of the file in bytes.
+*	@blocks: The size of the file on the disk in 512 byte blocks.
+*
+*	Returns: Nothing.
+*
+*/
+static inline void sizehist_add(int thread_id, int root, long long size, long long blocks) {
+	struct size_bucket *b = &size_buckets[(thread_id * size_stride + root) * NR_SIZE_BUCKETS];
+
+	b += size > 0 ? 64 - __builtin_clzll(size) : 0;
+	b->files++;
+	b->blocks += blocks;
+}
+
+#endif
@@ -0,0 +1,198 @@
+/*
+*	Scan statistics for --stats, see stats.h.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "stats.h"
+#include "lockprof.h"
+
+static void print_row(FILE *stream, const char *name, const struct thread_stats *s);
+static double ms(long long ns);
+
+//-------global variables--------
+bool stats_enabled = false;
+struct thread_stats *thread_stats;
+
+static int nr_stats;
+static long long scan_start;
+static long long scan_end;
+
+/*
+*	Allocates the statistics of every thread.
+*
+*	@thread_max: Number of threads, the main thread counts into thread 0.
+*
+*	Returns: Nothing.
+*
+*/
+void stats_init(int thread_max) {
+	nr_stats = thread_max;
+	if((thread_stats = aligned_alloc(64, thread_max * sizeof(struct thread_stats))) == NULL) {
+		perror("aligned_alloc 'thread_stats': ");
+		exit(EXIT_FAILURE);
+	}
+	memset(thread_stats, 0, thread_max * sizeof(struct thread_stats));
+#ifdef LOCKPROF
+	lockprof_init(thread_max);
+#endif
+}
+
+/*
+*	Marks the start of a worker.
+*
+*	@thread_id: The id of the worker.
+*
+*	Returns: Nothing.
+*
+*/
+void stats_thread_begin(int thread_id) {
+	thread_stats[thread_id].start_ns = stats_clock();
+}
+
+/*
+*	Marks the end of a worker and reads its context switches.
+*
+*	@thread_id: The id of the worker.
+*
+*	Returns: Nothing.
+*
+*/
+void stats_thread_end(int thread_id) {
+	struct rusage usage;
+
+	thread_stats[thread_id].end_ns = stats_clock();
+	if(getrusage(RUSAGE_THREAD, &usage) == 0) {
+		thread_stats[thread_id].nvcsw = usage.ru_nvcsw;
+		thread_stats[thread_id].nivcsw = usage.ru_nivcsw;
+	}
+}
+
+/*
+*	Marks the start of the scan, when the workers are started.
+*
+*	Returns: Nothing.
+*
+*/
+void stats_scan_begin(void) {
+	scan_start = stats_clock();
+}
+
+/*
+*	Marks the end of the scan, when the workers are joined.
+*
+*	Returns: Nothing.
+*
+*/
+void stats_scan_end(void) {
+	scan_end = stats_clock();
+}
+
+/*
+*	Prints the statistics of every thread, their sum and the derived rates.
+*
+*	@stream: Where to print.
+*
+*	Returns: Nothing.
+*
+*/
+void print_stats(FILE *stream) {
+	struct thread_stats total;
+	long long wall = scan_end - scan_start;
+	long long entries;
+	char name[16];
+
+	memset(&total, 0, sizeof(total));
+	fprintf(stream, "%-7s %9s %10s %10s %9s %9s %9s %10s %9s %9s %9s %8s %7s %7s %7s %7s\n",
+		"thread", "dirs", "files", "stat", "stat_ms", "open", "open_ms", "readdir", "rdir_ms",
+		"wait_ms", "idle_ms", "steals", "peak_q", "busy%", "nvcsw", "nivcsw");
+	for(int i = 0; i < nr_stats; i++) {
+		const struct thread_stats *s = &thread_stats[i];
+		snprintf(name, sizeof(name), "%d", i);
+		print_row(stream, name, s);
+
+		total.dirs += s->dirs;
+		total.files += s->files;
+		total.stat_calls += s->stat_calls;
+		total.stat_ns += s->stat_ns;
+		total.open_calls += s->open_calls;
+		total.open_ns += s->open_ns;
+		total.readdir_calls += s->readdir_calls;
+		total.readdir_ns += s->readdir_ns;
+		total.close_calls += s->close_calls;
+		total.close_ns += s->close_ns;
+		total.lock_wait_ns += s->lock_wait_ns;
+		total.idle_ns += s->idle_ns;
+		total.steals += s->steals;
+		total.peak_queue = s->peak_queue > total.peak_queue ? s->peak_queue : total.peak_queue;
+		total.busy_ns += s->busy_ns;
+		total.nvcsw += s->nvcsw;
+		total.nivcsw += s->nivcsw;
+	}
+	//The busy share of the total row is of all threads together.
+	total.start_ns = 0;
+	total.end_ns = wall * nr_stats;
+	print_row(stream, "total", &total);
+
+	entries = total.dirs + total.files;
+	fprintf(stream, "scan %.3f s, %lld entries, %.0f entries/s, closedir %lld calls %.3f ms,"
+		" parallel efficiency %.1f%%\n",
+		wall / 1e9, entries, wall > 0 ? entries / (wall / 1e9) : 0.0, total.close_calls, ms(total.close_ns),
+		wall > 0 ? 100.0 * total.busy_ns / ((double)wall * nr_stats) : 0.0);
+#ifdef LOCKPROF
+	print_lockprof(stream);
+#endif
+}
+
+/*
+*	Prints the statistics of one thread.
+*
+*	@stream: Where to print.
+*	@name: Name of the row.
+*	@s: The statistics.
+*
+*	Returns: Nothing.
+*
+*/
+static void print_row(FILE *stream, const char *name, const struct thread_stats *s) {
+	long long alive = s->end_ns - s->start_ns;
+
+	fprintf(stream, "%-7s %9lld %10lld %10lld %9.1f %9lld %9.1f %10lld %9.1f %9.1f %9.1f %8lld %7lld %7.1f %7ld %7ld\n",
+		name, s->dirs, s->files, s->stat_calls, ms(s->stat_ns), s->open_calls, ms(s->open_ns),
+		s->readdir_calls, ms(s->readdir_ns), ms(s->lock_wait_ns), ms(s->idle_ns), s->steals,
+		s->peak_queue, alive > 0 ? 100.0 * s->busy_ns / alive : 0.0, s->nvcsw, s->nivcsw);
+}
+
+/*
+*	Converts nanoseconds to milliseconds.
+*
+*	@ns: The time in nanoseconds.
+*
+*	Returns: The time in milliseconds.
+*
+*/
+static double ms(long long ns) {
+	return ns / 1e6;
+}
+
+/*
+*	Frees the statistics.
+*
+*	Returns: Nothing.
+*
+*/
+void stats_free(void) {
+	free(thread_stats);
+#ifdef LOCKPROF
+	lockprof_free();
+#endif
+}
@@ -0,0 +1,84 @@
+/*
+*	Scan statistics for --stats.
+*
+*	Every thread counts into its own cache line aligned struct, so collecting
+*	costs a clock read per call and no locks or atomics. The kernels count the
+*	filesystem calls when built with KF_STATS, the schedulers count waiting,
+*	idling, steals and queue depth when stats_enabled is set. The structs are
+*	summed and printed once the threads are joined.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+
+struct thread_stats {
+	long long dirs;
+	long long files;
+	long long stat_calls;
+	long long stat_ns;
+	long long open_calls;
+	long long open_ns;
+	long long readdir_calls;
+	long long readdir_ns;
+	long long close_calls;
+	long long close_ns;
+	long long lock_wait_ns;
+	long long idle_ns;
+	long long steals;
+	long long peak_queue;
+	long long busy_ns;
+	long long start_ns;
+	long long end_ns;
+	long nvcsw;
+	long nivcsw;
+} __attribute__((aligned(64)));
+
+extern bool stats_enabled;
+extern struct thread_stats *thread_stats;
+
+void stats_init(int thread_max);
+void stats_thread_begin(int thread_id);
+void stats_thread_end(int thread_id);
+void stats_scan_begin(void);
+void stats_scan_end(void);
+void print_stats(FILE *stream);
+void stats_free(void);
+
+/*
+*	Reads the monotonic clock if statistics are collected.
+*
+*	Returns: The time in nanoseconds, or 0 without --stats.
+*
+*/
+static inline long long stats_clock(void) {
+	struct timespec ts;
+	if(!stats_enabled) {
+		return 0;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+*	Remembers the deepest queue a thread has seen.
+*
+*	@thread_id: The id of the thread.
+*	@depth: The current depth of the queue.
+*
+*	Returns: Nothing.
+*
+*/
+static inline void stats_queue_depth(int thread_id, long long depth) {
+	if(stats_enabled && depth > thread_stats[thread_id].peak_queue) {
+		thread_stats[thread_id].peak_queue = depth;
+	}
+}
+
+#endif
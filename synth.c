@@ -0,0 +1,262 @@
+/*
+*	In-memory filesystem backend built from a shape spec.
+*
+*	Nothing is stored, every listing and stat is computed from the node ids
+*	of shape.c, so trees of any size cost no memory and no system calls. The
+*	node id and depth of a directory are encoded in its name, "d.<depth>.<id>",
+*	and files are named "f.<index>", so a path only has to be parsed from the
+*	end to find what it refers to. Any path that does not end in such a name is
+*	the root. Denied directories fail to open with EACCES, like they do for a
+*	user without privileges on a tree from gen-tree.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "fs.h"
+#include "shape.h"
+
+#define SYNTH_BLOCK 4096
+
+struct synth_dir {
+	unsigned long long node;
+	int depth;
+	int pos;
+	struct shape_dir d;
+	struct dirent entry;
+};
+
+static void *synth_opendir(const char *path);
+static struct dirent *synth_readdir(void *dir);
+static int synth_closedir(void *dir);
+static int synth_lstat(const char *path, struct stat *st);
+static bool parse_dir(const char *name, size_t len, unsigned long long *node, int *depth);
+static void parse_path(const char *path, unsigned long long *node, int *depth, int *file);
+static long long blocks(long long size);
+
+const struct fs_ops synth_fs = {
+	"synth", synth_opendir, synth_readdir, synth_closedir, synth_lstat
+};
+
+static struct shape synth_shape;
+
+/*
+*	Parses the shape of the tree.
+*
+*	@spec: A shape spec.
+*
+*	Returns: False if the spec is not valid.
+*
+*/
+bool synth_init(const char *spec) {
+	return parse_shape(spec, &synth_shape);
+}
+
+/*
+*	Parses a directory name of the form "d.<depth>.<id>".
+*
+*	@name: The name, it does not have to be terminated.
+*	@len: Length of the name.
+*	@node: Where the node id is stored.
+*	@depth: Where the depth is stored.
+*
+*	Returns: False if the name is not a directory name.
+*
+*/
+static bool parse_dir(const char *name, size_t len, unsigned long long *node, int *depth) {
+	char *end;
+
+	if(len < 5 || name[0] != 'd' || name[1] != '.') {
+		return false;
+	}
+	*depth = strtol(name + 2, &end, 10);
+	if(*end != '.') {
+		return false;
+	}
+	*node = strtoull(end + 1, &end, 16);
+	return end == name + len;
+}
+
+/*
+*	Finds the node a path refers to.
+*
+*	@path: The path.
+*	@node: Where the node id of the directory, or the directory of the file,
+*				 is stored.
+*	@depth: Where the depth of that directory is stored.
+*	@file: Where the index of the file is stored, -1 for a directory.
+*
+*	Returns: Nothing.
+*
+*/
+static void parse_path(const char *path, unsigned long long *node, int *depth, int *file) {
+	const char *end = path + strlen(path);
+	const char *name;
+
+	*file = -1;
+	*node = shape_root(&synth_shape);
+	*depth = 0;
+
+	//Skip trailing slashes.
+	while(end > path && end[-1] == '/') {
+		end--;
+	}
+	for(name = end; name > path && name[-1] != '/'; name--);
+
+	if(end - name > 2 && name[0] == 'f' && name[1] == '.') {
+		*file = atoi(name + 2);
+		end = name;
+		while(end > path && end[-1] == '/') {
+			end--;
+		}
+		for(name = end; name > path && name[-1] != '/'; name--);
+	}
+
+	if(!parse_dir(name, end - name, node, depth)) {
+		*node = shape_root(&synth_shape);
+		*depth = 0;
+	}
+}
+
+/*
+*	Opens a directory.
+*
+*	@path: The directory.
+*
+*	Returns: The handle, or NULL with errno set to EACCES for a denied
+*	directory and ENOTDIR for a file.
+*
+*/
+static void *synth_opendir(const char *path) {
+	struct synth_dir *dir;
+	int file;
+
+	if((dir = malloc(sizeof(struct synth_dir))) == NULL) {
+		return NULL;
+	}
+	parse_path(path, &dir->node, &dir->depth, &file);
+	if(file >= 0) {
+		free(dir);
+		errno = ENOTDIR;
+		return NULL;
+	}
+	describe_dir(&synth_shape, dir->node, dir->depth, &dir->d);
+	if(dir->d.denied) {
+		free(dir);
+		errno = EACCES;
+		return NULL;
+	}
+	dir->pos = 0;
+	return dir;
+}
+
+/*
+*	Reads the next entry: ".", "..", the files and then the subdirectories.
+*
+*	@dir: The handle.
+*
+*	Returns: The entry or NULL at the end of the directory.
+*
+*/
+static struct dirent *synth_readdir(void *dir) {
+	struct synth_dir *d = dir;
+	int i = d->pos - 2;
+
+	if(i >= d->d.nr_files + d->d.nr_dirs) {
+		return NULL;
+	}
+
+	if(i < 0) {
+		strcpy(d->entry.d_name, i == -2 ? "." : "..");
+		d->entry.d_type = DT_DIR;
+		d->entry.d_ino = d->node;
+	}
+	else if(i < d->d.nr_files) {
+		snprintf(d->entry.d_name, sizeof(d->entry.d_name), "f.%d", i);
+		d->entry.d_type = DT_REG;
+		d->entry.d_ino = d->node + i + 1;
+	}
+	else {
+		unsigned long long child = shape_child(&synth_shape, d->node, i - d->d.nr_files);
+		snprintf(d->entry.d_name, sizeof(d->entry.d_name), "d.%d.%llx", d->depth + 1, child);
+		d->entry.d_type = DT_DIR;
+		d->entry.d_ino = child;
+	}
+
+	d->pos++;
+	return &d->entry;
+}
+
+/*
+*	Closes a directory.
+*
+*	@dir: The handle.
+*
+*	Returns: 0.
+*
+*/
+static int synth_closedir(void *dir) {
+	free(dir);
+	return 0;
+}
+
+/*
+*	Fills in the stat struct of a path. Directories are one block, files use
+*	as many blocks as their size needs and sparse files a single block.
+*	Hardlinks share the inode of the file they link to.
+*
+*	@path: The path.
+*	@st: The stat struct.
+*
+*	Returns: 0.
+*
+*/
+static int synth_lstat(const char *path, struct stat *st) {
+	unsigned long long node;
+	int depth, file;
+
+	memset(st, 0, sizeof(struct stat));
+	parse_path(path, &node, &depth, &file);
+	st->st_blksize = SYNTH_BLOCK;
+
+	if(file < 0) {
+		st->st_mode = S_IFDIR | 0755;
+		st->st_ino = node;
+		st->st_nlink = 2;
+		st->st_size = SYNTH_BLOCK;
+		st->st_blocks = blocks(SYNTH_BLOCK);
+		return 0;
+	}
+
+	struct shape_file f;
+	describe_file(&synth_shape, node, file, &f);
+	st->st_mode = S_IFREG | 0644;
+	st->st_ino = node + (f.link >= 0 ? f.link : file) + 1;
+	st->st_nlink = f.link >= 0 ? 2 : 1;
+	if(f.link >= 0) {
+		describe_file(&synth_shape, node, f.link, &f);
+	}
+	st->st_size = f.size;
+	st->st_blocks = f.sparse ? blocks(1) : blocks(f.size);
+	return 0;
+}
+
+/*
+*	Number of 512 byte blocks used by a file of the given size.
+*
+*	@size: Size in bytes.
+*
+*	Returns: The number of blocks.
+*
+*/
+static long long blocks(long long size) {
+	return (size + SYNTH_BLOCK - 1) / SYNTH_BLOCK * (SYNTH_BLOCK / 512);
+}
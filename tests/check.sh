@@ -0,0 +1,65 @@
+#!/bin/bash
+#
+#	Smoke tests for mdu.
+#
+#	Generates a small tree with gen-tree and runs mdu over it with option
+#	combinations that have broken before, checking the exit status and that
+#	the total matches the manifest.
+#
+#	Author: Leo Juneblad (c19lsd)
+#
+# Version: 2.0
+
+cd "$(dirname "$0")/.." || exit 1
+
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+./tools/gen-tree "balanced,seed=1,depth=3,fanout=4" "$tmp/tree" || exit 1
+kib=$(sed -n 's/^kib=//p' "$tmp/tree.manifest")
+
+#	Runs mdu and checks that it succeeds and prints the total of the tree.
+#
+#	$1: Name of the test.
+#	$@: Arguments to mdu after the name, the tree is appended.
+check() {
+	local name=$1 out
+	shift
+	if ! out=$(./mdu "$@" "$tmp/tree" 2>"$tmp/stderr"); then
+		echo "FAIL $name: exit status" >&2
+		cat "$tmp/stderr" >&2
+		failed=1
+	elif [ "$(head -n 1 <<<"$out" | cut -f 1)" != "$kib" ]; then
+		echo "FAIL $name: expected $kib, got '$(head -n 1 <<<"$out")'" >&2
+		failed=1
+	else
+		echo "ok   $name"
+	fi
+}
+
+#	Runs mdu and checks that it rejects the arguments.
+#
+#	$1: Name of the test.
+#	$@: Arguments to mdu after the name, the tree is appended.
+reject() {
+	local name=$1
+	shift
+	if ./mdu "$@" "$tmp/tree" >/dev/null 2>&1; then
+		echo "FAIL $name: not rejected" >&2
+		failed=1
+	else
+		echo "ok   $name"
+	fi
+}
+
+check plain
+check syscall-latency-0 --syscall-latency=0 -j 4
+check mem-limit-record --mem-limit=1K --record="$tmp/trace"
+check mem-limit-replay --fs=replay:"$tmp/trace"
+check mem-limit-top --mem-limit=1K --top=3 --stats
+reject inodes-record --inodes --record="$tmp/inodes.trace"
+reject threads-0 -j 0
+reject threads-abc -j abc
+
+exit $failed
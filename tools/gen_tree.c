@@ -0,0 +1,293 @@
+/*
+*	Generates a directory tree from a shape spec, see shape.h.
+*
+*	usage: gen-tree [-m manifest] spec dir
+*
+*	The tree is created in dir, which must not exist. A manifest with the
+*	totals mdu should print for the tree is written to dir.manifest or to the
+*	file given with -m, one key=value per line:
+*
+*	kib: What mdu prints, every hardlink counted.
+*	kib_unique: What du prints, hardlinks counted once.
+*	kib_unprivileged: What mdu prints when run by a user that cannot read the
+*										denied directories.
+*	errors_unprivileged: How many errors mdu reports in that case.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "shape.h"
+
+#define WRITE_CHUNK (64 * 1024)
+
+struct totals {
+	long long dirs;
+	long long files;
+	long long links;
+	long long sparse;
+	long long denied;
+	long long bytes;
+	long long blocks;
+	long long link_blocks;
+	long long hidden_blocks;
+	long long hidden_errors;
+};
+
+static long long create_dir(const char *path, unsigned long long node, int depth, bool hidden);
+static long long create_file(const char *path, const char *dir, unsigned long long node, int index);
+static void write_data(int fd, const char *path, long long size);
+static long long count_entry(const char *path);
+static void write_manifest(const char *path, const char *dir);
+static void fail(const char *what, const char *path);
+
+//-------global variables--------
+static struct shape shape;
+static struct totals totals;
+static char zeros[WRITE_CHUNK];
+
+int main(int argc, char *argv[]) {
+	const char *manifest = NULL;
+	char default_manifest[PATH_MAX];
+	int opt;
+
+	while((opt = getopt(argc, argv, "m:")) != -1) {
+		switch(opt) {
+			case 'm':
+			manifest = optarg;
+			break;
+			default:
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if(argc - optind != 2) {
+		fprintf(stderr, "usage: gen-tree [-m manifest] spec dir\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(!parse_shape(argv[optind], &shape)) {
+		fprintf(stderr, "invalid spec '%s', expected ", argv[optind]);
+		list_shapes(stderr);
+		fprintf(stderr, "[,key=value...]\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if(manifest == NULL) {
+		snprintf(default_manifest, sizeof(default_manifest), "%s.manifest", argv[optind + 1]);
+		manifest = default_manifest;
+	}
+
+	//The root is measured by lstat in mdu as well, so it counts like any entry.
+	create_dir(argv[optind + 1], shape_root(&shape), 0, false);
+	count_entry(argv[optind + 1]);
+	totals.dirs++;
+
+	write_manifest(manifest, argv[optind + 1]);
+	return 0;
+}
+
+/*
+*	Creates a directory and everything in it.
+*
+*	@path: The path of the directory.
+*	@node: The node id of the directory.
+*	@depth: The depth of the directory.
+*	@hidden: True if a parent is denied, so mdu cannot see the directory when
+*					 run without privileges.
+*
+*	Returns: Number of blocks of the contents of the directory, not counting
+*	the directory itself.
+*
+*/
+static long long create_dir(const char *path, unsigned long long node, int depth, bool hidden) {
+	struct shape_dir d;
+	char child[PATH_MAX];
+	long long blocks = 0;
+
+	describe_dir(&shape, node, depth, &d);
+
+	if(mkdir(path, 0755) < 0) {
+		fail("mkdir", path);
+	}
+
+	for(int i = 0; i < d.nr_files; i++) {
+		snprintf(child, sizeof(child), "%s/f%d", path, i);
+		blocks += create_file(child, path, node, i);
+	}
+
+	for(int i = 0; i < d.nr_dirs; i++) {
+		if(snprintf(child, sizeof(child), "%s/d%d", path, i) >= (int)sizeof(child)) {
+			errno = ENAMETOOLONG;
+			fail("mkdir", path);
+		}
+		blocks += create_dir(child, shape_child(&shape, node, i), depth + 1, hidden || d.denied);
+		blocks += count_entry(child);
+		totals.dirs++;
+	}
+
+	if(d.denied) {
+		totals.denied++;
+		if(!hidden) {
+			totals.hidden_blocks += blocks;
+			totals.hidden_errors++;
+		}
+		if(chmod(path, 0) < 0) {
+			fail("chmod", path);
+		}
+	}
+	return blocks;
+}
+
+/*
+*	Creates a file, or a hardlink to an earlier file in the same directory.
+*
+*	@path: The path of the file.
+*	@dir: The path of the directory.
+*	@node: The node id of the directory.
+*	@index: The index of the file.
+*
+*	Returns: Number of blocks of the file.
+*
+*/
+static long long create_file(const char *path, const char *dir, unsigned long long node, int index) {
+	struct shape_file f;
+	long long blocks;
+	int fd;
+
+	describe_file(&shape, node, index, &f);
+
+	if(f.link >= 0) {
+		char target[PATH_MAX];
+		snprintf(target, sizeof(target), "%s/f%d", dir, f.link);
+		if(link(target, path) < 0) {
+			fail("link", path);
+		}
+		blocks = count_entry(path);
+		totals.links++;
+		totals.link_blocks += blocks;
+		return blocks;
+	}
+
+	if((fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) {
+		fail("open", path);
+	}
+	if(f.sparse) {
+		//Only the last byte is written, the rest of the file is a hole.
+		if(ftruncate(fd, f.size) < 0 || pwrite(fd, "", 1, f.size > 0 ? f.size - 1 : 0) < 0) {
+			fail("write", path);
+		}
+		totals.sparse++;
+	}
+	else {
+		write_data(fd, path, f.size);
+	}
+	if(close(fd) < 0) {
+		fail("close", path);
+	}
+
+	totals.files++;
+	return count_entry(path);
+}
+
+/*
+*	Writes zeros to a file.
+*
+*	@fd: The file.
+*	@path: The path of the file, used in error messages.
+*	@size: Number of bytes to write.
+*
+*	Returns: Nothing.
+*
+*/
+static void write_data(int fd, const char *path, long long size) {
+	while(size > 0) {
+		ssize_t n = write(fd, zeros, size < WRITE_CHUNK ? size : WRITE_CHUNK);
+		if(n < 0) {
+			fail("write", path);
+		}
+		size -= n;
+	}
+}
+
+/*
+*	Adds the blocks and size of an entry to the totals.
+*
+*	@path: The path of the entry.
+*
+*	Returns: Number of blocks of the entry.
+*
+*/
+static long long count_entry(const char *path) {
+	struct stat st;
+
+	if(lstat(path, &st) < 0) {
+		fail("lstat", path);
+	}
+	totals.bytes += st.st_size;
+	totals.blocks += st.st_blocks;
+	return st.st_blocks;
+}
+
+/*
+*	Writes the manifest.
+*
+*	@path: The path of the manifest.
+*	@dir: The path of the generated tree.
+*
+*	Returns: Nothing.
+*
+*/
+static void write_manifest(const char *path, const char *dir) {
+	char spec[512];
+	FILE *f;
+
+	if((f = fopen(path, "w")) == NULL) {
+		fail("fopen", path);
+	}
+
+	format_shape(&shape, spec, sizeof(spec));
+	fprintf(f, "spec=%s\n", spec);
+	fprintf(f, "dir=%s\n", dir);
+	fprintf(f, "dirs=%lld\n", totals.dirs);
+	fprintf(f, "files=%lld\n", totals.files);
+	fprintf(f, "hardlinks=%lld\n", totals.links);
+	fprintf(f, "sparse_files=%lld\n", totals.sparse);
+	fprintf(f, "denied_dirs=%lld\n", totals.denied);
+	fprintf(f, "entries=%lld\n", totals.dirs + totals.files + totals.links);
+	fprintf(f, "apparent_bytes=%lld\n", totals.bytes);
+	fprintf(f, "blocks=%lld\n", totals.blocks);
+	fprintf(f, "kib=%lld\n", totals.blocks / 2);
+	fprintf(f, "kib_unique=%lld\n", (totals.blocks - totals.link_blocks) / 2);
+	fprintf(f, "kib_unprivileged=%lld\n", (totals.blocks - totals.hidden_blocks) / 2);
+	fprintf(f, "errors_unprivileged=%lld\n", totals.hidden_errors);
+
+	if(fclose(f) != 0) {
+		fail("fclose", path);
+	}
+}
+
+/*
+*	Prints an error for a failed call and exits.
+*
+*	@what: The name of the call.
+*	@path: The path it failed on.
+*
+*	Returns: Nothing.
+*
+*/
+static void fail(const char *what, const char *path) {
+	fprintf(stderr, "%s '%s': ", what, path);
+	perror("");
+	exit(EXIT_FAILURE);
+}
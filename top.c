@@ -0,0 +1,300 @@
+/*
+*	The largest directories and files for --top, see top.h.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "top.h"
+#include "mem.h"
+
+struct top_entry {
+	long long blocks;
+	char *path;
+};
+
+struct top_heap {
+	struct top_entry *entries;
+	int len;
+};
+
+struct top_heaps {
+	struct top_heap dirs;
+	struct top_heap files;
+} __attribute__((aligned(64)));
+
+static bool smaller(const struct top_entry *a, const struct top_entry *b);
+static void offer(struct top_heap *h, long long blocks, const char *path);
+static void sift_down(struct top_heap *h, int i);
+static int compare_entries(const void *a, const void *b);
+static void print_heaps(const char *title, bool dirs);
+
+//-------global variables--------
+static int top_max = 0;
+static struct top_heaps *heaps;
+static int nr_heaps;
+
+/*
+*	Allocates the heaps of every thread.
+*
+*	@thread_max: Number of threads, the main thread uses the heaps of thread 0.
+*	@n: How many directories and files to keep.
+*
+*	Returns: Nothing.
+*
+*/
+void top_init(int thread_max, int n) {
+	top_max = n;
+	nr_heaps = thread_max;
+	if((heaps = aligned_alloc(64, thread_max * sizeof(struct top_heaps))) == NULL) {
+		perror("aligned_alloc 'heaps': ");
+		exit(EXIT_FAILURE);
+	}
+	for(int i = 0; i < thread_max; i++) {
+		heaps[i].dirs.len = 0;
+		heaps[i].files.len = 0;
+		if((heaps[i].dirs.entries = malloc(n * sizeof(struct top_entry))) == NULL ||
+				(heaps[i].files.entries = malloc(n * sizeof(struct top_entry))) == NULL) {
+			perror("malloc 'heaps': ");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+/*
+*	Creates the node of a directory that is about to be queued.
+*
+*	@parent: The node of the directory it was found in, NULL for a given file.
+*	@name: The path of the directory, owned by the node from now on.
+*
+*	Returns: The node.
+*
+*/
+struct top_node *top_new(struct top_node *parent, char *name) {
+	struct top_node *node;
+
+	if((node = malloc(sizeof(struct top_node))) == NULL) {
+		perror("malloc 'top_node': ");
+		exit(EXIT_FAILURE);
+	}
+	mem_add(MEM_PATHS, sizeof(struct top_node));
+	node->parent = parent;
+	node->name = name;
+	node->own_blocks = 0;
+	atomic_init(&node->blocks, 0);
+	atomic_init(&node->pending, 1);
+	if(parent != NULL) {
+		atomic_fetch_add(&parent->pending, 1);
+	}
+	return node;
+}
+
+/*
+*	Marks a directory as measured. Every directory whose whole subtree is then
+*	measured, going up from this one, is offered to the heap and freed.
+*
+*	@thread_id: The id of the calling thread.
+*	@node: The node of the directory.
+*	@own_blocks: The size of the directory itself.
+*	@blocks: The size of its entries.
+*
+*	Returns: Nothing.
+*
+*/
+void top_dir_done(int thread_id, struct top_node *node, long long own_blocks, long long blocks) {
+	node->own_blocks = own_blocks;
+	atomic_fetch_add(&node->blocks, blocks);
+
+	while(node != NULL && atomic_fetch_sub(&node->pending, 1) == 1) {
+		struct top_node *parent = node->parent;
+		long long below = atomic_load(&node->blocks);
+
+		offer(&heaps[thread_id].dirs, node->own_blocks + below, node->name);
+		//The directory itself is already in the size of the parent's entries.
+		if(parent != NULL) {
+			atomic_fetch_add(&parent->blocks, below);
+		}
+		free(node->name);
+		free(node);
+		mem_add(MEM_PATHS, -(long long)sizeof(struct top_node));
+		node = parent;
+	}
+}
+
+/*
+*	Offers a file that is not a directory to the heap of a thread.
+*
+*	@thread_id: The id of the calling thread.
+*	@blocks: The size of the file.
+*	@path: The path of the file, copied if it is kept.
+*
+*	Returns: Nothing.
+*
+*/
+void top_file(int thread_id, long long blocks, const char *path) {
+	offer(&heaps[thread_id].files, blocks, path);
+}
+
+/*
+*	Checks if an entry belongs closer to the top of a heap than another one,
+*	being smaller or, with the same size, later by path.
+*
+*	@a: The first entry.
+*	@b: The second entry.
+*
+*	Returns: True if the first entry is smaller.
+*
+*/
+static bool smaller(const struct top_entry *a, const struct top_entry *b) {
+	if(a->blocks != b->blocks) {
+		return a->blocks < b->blocks;
+	}
+	return strcmp(a->path, b->path) > 0;
+}
+
+/*
+*	Keeps an entry in a heap if it is among the largest.
+*
+*	@h: The heap, the smallest entry is at the top.
+*	@blocks: The size.
+*	@path: The path, copied if it is kept.
+*
+*	Returns: Nothing.
+*
+*/
+static void offer(struct top_heap *h, long long blocks, const char *path) {
+	struct top_entry e = {blocks, (char *)path};
+	int i;
+
+	if(h->len == top_max && !smaller(&h->entries[0], &e)) {
+		return;
+	}
+	if((e.path = strdup(path)) == NULL) {
+		perror("strdup: ");
+		exit(EXIT_FAILURE);
+	}
+
+	if(h->len == top_max) {
+		free(h->entries[0].path);
+		h->entries[0] = e;
+		sift_down(h, 0);
+		return;
+	}
+
+	//Sift up.
+	for(i = h->len++; i > 0 && smaller(&e, &h->entries[(i - 1) / 2]); i = (i - 1) / 2) {
+		h->entries[i] = h->entries[(i - 1) / 2];
+	}
+	h->entries[i] = e;
+}
+
+/*
+*	Moves an entry down until neither child is smaller.
+*
+*	@h: The heap.
+*	@i: Index of the entry.
+*
+*	Returns: Nothing.
+*
+*/
+static void sift_down(struct top_heap *h, int i) {
+	struct top_entry e = h->entries[i];
+
+	while(2 * i + 1 < h->len) {
+		int child = 2 * i + 1;
+		if(child + 1 < h->len && smaller(&h->entries[child + 1], &h->entries[child])) {
+			child++;
+		}
+		if(!smaller(&h->entries[child], &e)) {
+			break;
+		}
+		h->entries[i] = h->entries[child];
+		i = child;
+	}
+	h->entries[i] = e;
+}
+
+/*
+*	Orders entries from the largest to the smallest.
+*
+*	@a: The first entry.
+*	@b: The second entry.
+*
+*	Returns: Less than, equal to or greater than zero like strcmp.
+*
+*/
+static int compare_entries(const void *a, const void *b) {
+	const struct top_entry *x = a;
+	const struct top_entry *y = b;
+	if(x->blocks != y->blocks) {
+		return x->blocks < y->blocks ? 1 : -1;
+	}
+	return strcmp(x->path, y->path);
+}
+
+/*
+*	Merges the heaps of every thread and prints the largest entries.
+*
+*	@title: The line printed before them.
+*	@dirs: True for the directories, false for the files.
+*
+*	Returns: Nothing.
+*
+*/
+static void print_heaps(const char *title, bool dirs) {
+	struct top_entry *all;
+	int len = 0;
+
+	if((all = malloc(nr_heaps * top_max * sizeof(struct top_entry))) == NULL) {
+		perror("malloc: ");
+		exit(EXIT_FAILURE);
+	}
+	for(int i = 0; i < nr_heaps; i++) {
+		struct top_heap *h = dirs ? &heaps[i].dirs : &heaps[i].files;
+		memcpy(all + len, h->entries, h->len * sizeof(struct top_entry));
+		len += h->len;
+	}
+	qsort(all, len, sizeof(struct top_entry), compare_entries);
+
+	printf("%s\n", title);
+	for(int i = 0; i < len && i < top_max; i++) {
+		printf("%lld\t%s\n", all[i].blocks / 2, all[i].path);
+	}
+	free(all);
+}
+
+/*
+*	Prints the largest directories and files, like the totals in KiB.
+*
+*	Returns: Nothing.
+*
+*/
+void print_top(void) {
+	print_heaps("largest directories:", true);
+	print_heaps("largest files:", false);
+}
+
+/*
+*	Frees the heaps.
+*
+*	Returns: Nothing.
+*
+*/
+void top_free(void) {
+	for(int i = 0; i < nr_heaps; i++) {
+		for(int j = 0; j < heaps[i].dirs.len; j++) {
+			free(heaps[i].dirs.entries[j].path);
+		}
+		for(int j = 0; j < heaps[i].files.len; j++) {
+			free(heaps[i].files.entries[j].path);
+		}
+		free(heaps[i].dirs.entries);
+		free(heaps[i].files.entries);
+	}
+	free(heaps);
+}
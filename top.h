@@ -0,0 +1,44 @@
+/*
+*	The largest directories and files for --top.
+*
+*	Every worker keeps two bounded min-heaps of the N largest directories and
+*	files it has seen, they are merged when the scan is done, so the memory
+*	does not grow with the tree.
+*
+*	The size of a directory includes everything below it, which is only known
+*	when its whole subtree is measured. Every directory that is queued or
+*	being measured has a node with its parent and the number of its
+*	directories that are not finished, itself included. The last one to finish
+*	adds the size to the parent and frees the node, so only the nodes of
+*	unfinished subtrees exist at any time. A node owns the path of its
+*	directory.
+*
+*	Entries of the same size are ordered by path, so the output does not
+*	depend on the scheduler or the number of threads.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef TOP_H
+#define TOP_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+struct top_node {
+	struct top_node *parent;
+	char *name;
+	long long own_blocks;
+	atomic_llong blocks;
+	atomic_long pending;
+};
+
+void top_init(int thread_max, int n);
+struct top_node *top_new(struct top_node *parent, char *name);
+void top_dir_done(int thread_id, struct top_node *node, long long own_blocks, long long blocks);
+void top_file(int thread_id, long long blocks, const char *path);
+void print_top(void);
+void top_free(void);
+
+#endif
@@ -0,0 +1,325 @@
+/*
+*	Timeline of worker activity for --trace, see trace.h.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+#include "trace.h"
+#include "mem.h"
+
+#define TRACE_RING_SIZE 4096
+#define TRACE_NAME_LEN 96
+#define TRACE_DRAIN_NS 10000000
+
+enum trace_type {
+	TRACE_DIR,
+	TRACE_WAIT,
+	TRACE_STEAL
+};
+
+struct trace_event {
+	long long ts;
+	long long dur;
+	int type;
+	int arg;
+	char name[TRACE_NAME_LEN];
+};
+
+//Written by its worker at the tail, read by the writer thread at the head.
+struct trace_ring {
+	struct trace_event events[TRACE_RING_SIZE];
+	atomic_size_t head;
+	atomic_size_t tail;
+	long long dropped;
+	long long nr_dirs;
+	long long nr_waits;
+	bool sampled;
+	struct trace_event dir;
+} __attribute__((aligned(64)));
+
+static void put_event(int thread_id, const struct trace_event *e);
+static void *writer_func(void *arg);
+static void drain(void);
+static void write_event(int thread_id, const struct trace_event *e);
+static void write_string(const char *s);
+
+//-------global variables--------
+bool trace_enabled = false;
+
+static struct trace_ring *rings;
+static int nr_rings;
+static int trace_sample;
+static FILE *trace_file;
+static long long trace_start;
+static bool first_event;
+static atomic_bool trace_stop;
+static pthread_t writer;
+
+/*
+*	Creates the trace file, the rings and starts the writer thread.
+*
+*	@path: The file to write.
+*	@thread_max: Number of workers.
+*	@sample: Keep every sample:th directory of each worker.
+*
+*	Returns: Nothing.
+*
+*/
+void trace_open(const char *path, int thread_max, int sample) {
+	if((trace_file = fopen(path, "w")) == NULL) {
+		fprintf(stderr, "cannot create trace '%s': ", path);
+		perror("");
+		exit(EXIT_FAILURE);
+	}
+	if((rings = aligned_alloc(64, thread_max * sizeof(struct trace_ring))) == NULL) {
+		perror("aligned_alloc 'rings': ");
+		exit(EXIT_FAILURE);
+	}
+	memset(rings, 0, thread_max * sizeof(struct trace_ring));
+	mem_add(MEM_BUFFERS, thread_max * sizeof(struct trace_ring));
+	nr_rings = thread_max;
+	trace_sample = sample > 0 ? sample : 1;
+	trace_start = trace_clock();
+	first_event = true;
+	atomic_store(&trace_stop, false);
+
+	fprintf(trace_file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	for(int i = 0; i < thread_max; i++) {
+		fprintf(trace_file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d,"
+			" \"args\": {\"name\": \"worker %d\"}}", first_event ? "" : ",\n", i, i);
+		first_event = false;
+	}
+
+	if(pthread_create(&writer, NULL, writer_func, NULL) != 0) {
+		perror("pthread_create: ");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+*	Starts the event of a directory, if it is sampled. The name is copied
+*	since the kernel frees it.
+*
+*	@thread_id: The id of the worker.
+*	@name: The path of the directory.
+*
+*	Returns: Nothing.
+*
+*/
+void trace_dir_begin(int thread_id, const char *name) {
+	struct trace_ring *r = &rings[thread_id];
+	size_t len = strlen(name);
+
+	r->sampled = r->nr_dirs++ % trace_sample == 0;
+	if(!r->sampled) {
+		return;
+	}
+	//Long paths keep their end, which is the part that tells them apart.
+	if(len >= TRACE_NAME_LEN) {
+		name += len - (TRACE_NAME_LEN - 1);
+	}
+	strcpy(r->dir.name, name);
+	r->dir.type = TRACE_DIR;
+	r->dir.arg = 0;
+	r->dir.ts = trace_clock();
+}
+
+/*
+*	Finishes the event of a directory.
+*
+*	@thread_id: The id of the worker.
+*
+*	Returns: Nothing.
+*
+*/
+void trace_dir_end(int thread_id) {
+	struct trace_ring *r = &rings[thread_id];
+
+	if(r->sampled) {
+		r->dir.dur = trace_clock() - r->dir.ts;
+		put_event(thread_id, &r->dir);
+	}
+}
+
+/*
+*	Adds the time a worker blocked waiting for work, sampled like the
+*	directories.
+*
+*	@thread_id: The id of the worker.
+*	@start: When it started waiting, from trace_clock().
+*
+*	Returns: Nothing.
+*
+*/
+void trace_wait(int thread_id, long long start) {
+	struct trace_event e = {start, trace_clock() - start, TRACE_WAIT, 0, "wait"};
+
+	if(rings[thread_id].nr_waits++ % trace_sample == 0) {
+		put_event(thread_id, &e);
+	}
+}
+
+/*
+*	Adds a steal.
+*
+*	@thread_id: The id of the thief.
+*	@victim: The worker the directory was stolen from.
+*
+*	Returns: Nothing.
+*
+*/
+void trace_steal(int thread_id, int victim) {
+	struct trace_event e = {trace_clock(), 0, TRACE_STEAL, victim, "steal"};
+	put_event(thread_id, &e);
+}
+
+/*
+*	Puts an event in the ring of a worker, or drops it if the ring is full.
+*
+*	@thread_id: The id of the worker.
+*	@e: The event.
+*
+*	Returns: Nothing.
+*
+*/
+static void put_event(int thread_id, const struct trace_event *e) {
+	struct trace_ring *r = &rings[thread_id];
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+	if(tail - atomic_load_explicit(&r->head, memory_order_acquire) == TRACE_RING_SIZE) {
+		r->dropped++;
+		return;
+	}
+	r->events[tail % TRACE_RING_SIZE] = *e;
+	atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+/*
+*	Writer thread, drains the rings until the trace is closed.
+*
+*	@arg: Unused.
+*
+*	Returns: NULL.
+*
+*/
+static void *writer_func(void *arg) {
+	struct timespec pause = {0, TRACE_DRAIN_NS};
+
+	(void)arg;
+	while(!atomic_load(&trace_stop)) {
+		drain();
+		nanosleep(&pause, NULL);
+	}
+	drain();
+	return NULL;
+}
+
+/*
+*	Writes every event that is in the rings.
+*
+*	Returns: Nothing.
+*
+*/
+static void drain(void) {
+	for(int i = 0; i < nr_rings; i++) {
+		struct trace_ring *r = &rings[i];
+		size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+		size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+		for(; head != tail; head++) {
+			write_event(i, &r->events[head % TRACE_RING_SIZE]);
+		}
+		atomic_store_explicit(&r->head, head, memory_order_release);
+	}
+}
+
+/*
+*	Writes one event as JSON.
+*
+*	@thread_id: The worker the event belongs to.
+*	@e: The event.
+*
+*	Returns: Nothing.
+*
+*/
+static void write_event(int thread_id, const struct trace_event *e) {
+	double ts = (e->ts - trace_start) / 1e3;
+
+	fputs(first_event ? "" : ",\n", trace_file);
+	first_event = false;
+	switch(e->type) {
+		case TRACE_DIR:
+		fprintf(trace_file, "{\"name\": \"dir\", \"cat\": \"scan\", \"ph\": \"X\", \"ts\": %.3f,"
+			" \"dur\": %.3f, \"pid\": 1, \"tid\": %d, \"args\": {\"path\": ", ts, e->dur / 1e3, thread_id);
+		write_string(e->name);
+		fputs("}}", trace_file);
+		break;
+		case TRACE_WAIT:
+		fprintf(trace_file, "{\"name\": \"wait\", \"cat\": \"sched\", \"ph\": \"X\", \"ts\": %.3f,"
+			" \"dur\": %.3f, \"pid\": 1, \"tid\": %d}", ts, e->dur / 1e3, thread_id);
+		break;
+		default:
+		fprintf(trace_file, "{\"name\": \"steal\", \"cat\": \"sched\", \"ph\": \"i\", \"s\": \"t\","
+			" \"ts\": %.3f, \"pid\": 1, \"tid\": %d, \"args\": {\"victim\": %d}}", ts, thread_id, e->arg);
+	}
+}
+
+/*
+*	Writes a JSON string, escaping what JSON does not allow as is.
+*
+*	@s: The string.
+*
+*	Returns: Nothing.
+*
+*/
+static void write_string(const char *s) {
+	fputc('"', trace_file);
+	for(; *s != '\0'; s++) {
+		unsigned char c = *s;
+		if(c == '"' || c == '\\') {
+			fprintf(trace_file, "\\%c", c);
+		}
+		else if(c < 0x20) {
+			fprintf(trace_file, "\\u%04x", c);
+		}
+		else {
+			fputc(c, trace_file);
+		}
+	}
+	fputc('"', trace_file);
+}
+
+/*
+*	Stops the writer thread, writes what is left and closes the trace.
+*
+*	Returns: Nothing.
+*
+*/
+void trace_close(void) {
+	long long dropped = 0;
+
+	atomic_store(&trace_stop, true);
+	if(pthread_join(writer, NULL) != 0) {
+		fprintf(stderr, "pthread_join trace writer\n");
+	}
+	fprintf(trace_file, "\n]}\n");
+	if(fclose(trace_file) != 0) {
+		perror("fclose trace: ");
+	}
+
+	for(int i = 0; i < nr_rings; i++) {
+		dropped += rings[i].dropped;
+	}
+	if(dropped > 0) {
+		fprintf(stderr, "trace: %lld events dropped, use --trace-sample to keep fewer\n", dropped);
+	}
+	free(rings);
+}
@@ -0,0 +1,47 @@
+/*
+*	Timeline of worker activity for --trace, in the Chrome trace event format
+*	that Perfetto and chrome://tracing open.
+*
+*	Every worker writes events to its own single producer ring, and a writer
+*	thread drains the rings to the file while the scan runs, so workers never
+*	take a lock or wait on the file. When a ring is full the event is dropped
+*	and counted instead of blocking the worker. Waits are only traced when a
+*	worker actually blocked. --trace-sample=n keeps only every n:th directory
+*	and wait of each worker to bound the size of large scans, steals are
+*	always kept.
+*
+*	Author: Leo Juneblad (c19lsd)
+*
+* Version: 2.0
+*/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <time.h>
+
+extern bool trace_enabled;
+
+void trace_open(const char *path, int thread_max, int sample);
+void trace_dir_begin(int thread_id, const char *name);
+void trace_dir_end(int thread_id);
+void trace_wait(int thread_id, long long start);
+void trace_steal(int thread_id, int victim);
+void trace_close(void);
+
+/*
+*	Reads the monotonic clock if a trace is written.
+*
+*	Returns: The time in nanoseconds, or 0 without --trace.
+*
+*/
+static inline long long trace_clock(void) {
+	struct timespec ts;
+	if(!trace_enabled) {
+		return 0;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#endif